@@ -0,0 +1,94 @@
+/**********************************************************************
+ * Copyright (c) 2019
+ *  Sang-Hoon Kim <sanghoonkim@ajou.ac.kr>
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License version 2 as
+ * published by the Free Software Foundation.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTIABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+ * GNU General Public License for more details.
+ *
+ **********************************************************************/
+
+#ifndef __ARENA_H__
+#define __ARENA_H__
+
+#include <stdlib.h>
+#include <string.h>
+#include <assert.h>
+
+/**
+ * Bump allocator for the objects living until the end of a simulation.
+ * Objects are carved out of large chunks in the allocation order, and are
+ * freed all at once by arena_destroy(). Use one arena per object type to keep
+ * the objects of the same type contiguous in memory.
+ */
+#define ARENA_ALIGN			16
+#define ARENA_MIN_CHUNK		(64 * 1024)
+#define ARENA_MAX_CHUNK		(64 * 1024 * 1024)
+
+struct arena_chunk {
+	struct arena_chunk *next;
+	size_t size;			/* # of bytes in @data */
+	size_t used;			/* # of bytes handed out from @data */
+	char data[] __attribute__((aligned(ARENA_ALIGN)));
+};
+
+struct arena {
+	struct arena_chunk *chunk;	/* The chunk to allocate from. Older chunks follow */
+	unsigned long nr_chunks;
+};
+
+static inline void arena_init(struct arena *arena)
+{
+	arena->chunk = NULL;
+	arena->nr_chunks = 0;
+}
+
+/**
+ * Allocate zero-filled @size bytes from @arena
+ */
+static inline void *arena_alloc(struct arena *arena, size_t size)
+{
+	struct arena_chunk *chunk = arena->chunk;
+	void *obj;
+
+	size = (size + ARENA_ALIGN - 1) & ~(size_t)(ARENA_ALIGN - 1);
+
+	if (!chunk || chunk->used + size > chunk->size) {
+		size_t chunk_size = chunk ? chunk->size * 2 : ARENA_MIN_CHUNK;
+
+		if (chunk_size > ARENA_MAX_CHUNK) chunk_size = ARENA_MAX_CHUNK;
+		if (chunk_size < size) chunk_size = size;
+
+		chunk = malloc(sizeof(*chunk) + chunk_size);
+		assert(chunk);
+		chunk->next = arena->chunk;
+		chunk->size = chunk_size;
+		chunk->used = 0;
+
+		arena->chunk = chunk;
+		arena->nr_chunks++;
+	}
+
+	obj = chunk->data + chunk->used;
+	chunk->used += size;
+
+	memset(obj, 0x00, size);
+	return obj;
+}
+
+static inline void arena_destroy(struct arena *arena)
+{
+	while (arena->chunk) {
+		struct arena_chunk *chunk = arena->chunk;
+		arena->chunk = chunk->next;
+		free(chunk);
+	}
+	arena->nr_chunks = 0;
+}
+
+#endif
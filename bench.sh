@@ -0,0 +1,42 @@
+#!/bin/sh
+#
+# Measure the throughput of the simulator for each scheduler over generated
+# workloads of increasing size. The results are written in CSV to $BENCH_OUT
+# (bench.csv by default) so that runs before and after a change can be
+# compared. Override the workload sizes with $BENCH_SIZES.
+#
+# Usage: ./bench.sh, or make bench
+
+SIZES=${BENCH_SIZES:-"1000 10000 100000 1000000 10000000"}
+SCHEDULERS=${BENCH_SCHEDULERS:-"f s S r p i"}
+OUT=${BENCH_OUT:-bench.csv}
+DIR=${BENCH_DIR:-${TMPDIR:-/tmp}/sched-bench}
+
+# Workloads: mildly overloaded bursts with some resource contention
+GEN_OPTS=${BENCH_GEN_OPTS:-"-a bursty -i 12 -m 10 -p 0:4,10:2,20:1 -c 20 -r 8"}
+
+set -e
+mkdir -p "$DIR"
+
+echo "scheduler,processes,ticks,seconds,ticks_per_second,ns_per_schedule,peak_rss_kb,allocations" > "$OUT"
+
+for n in $SIZES; do
+	workload="$DIR/bench-$n.wl"
+	if [ ! -f "$workload" ]; then
+		./gen -s 1 -n "$n" $GEN_OPTS > "$DIR/bench-$n.txt"
+		./sched --compile "$DIR/bench-$n.txt" -o "$workload"
+		rm -f "$DIR/bench-$n.txt"
+	fi
+
+	for s in $SCHEDULERS; do
+		./sched -q -t -o /dev/null -$s "$workload" | awk -F': *' -v s="$s" -v n="$n" '
+			/^Ticks  /			{ ticks = $2 }
+			/^Simulation time/	{ seconds = $2 + 0 }
+			/^Ticks\/second/	{ tps = $2 }
+			/^ns\/schedule/		{ ns = $2 }
+			/^Peak RSS/			{ rss = $2 + 0 }
+			/^Allocations/		{ allocs = $2 }
+			END { printf "%s,%s,%s,%s,%s,%s,%s,%s\n", s, n, ticks, seconds, tps, ns, rss, allocs }
+		' | tee -a "$OUT"
+	done
+done
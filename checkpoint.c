@@ -0,0 +1,142 @@
+/**********************************************************************
+ * Copyright (c) 2019
+ *  Sang-Hoon Kim <sanghoonkim@ajou.ac.kr>
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License version 2 as
+ * published by the Free Software Foundation.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTIABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+ * GNU General Public License for more details.
+ *
+ **********************************************************************/
+
+#include <stdlib.h>
+#include <string.h>
+
+#include "types.h"
+#include "list_head.h"
+
+#include "process.h"
+#include "checkpoint.h"
+
+void checkpoint_data(struct checkpoint *checkpoint, void *data, size_t size)
+{
+	if (!size) return;
+
+	if (checkpoint->failed) {
+		if (checkpoint->restoring) memset(data, 0x00, size);
+		return;
+	}
+
+	if (checkpoint->restoring) {
+		if (fread(data, size, 1, checkpoint->file) != 1) {
+			memset(data, 0x00, size);
+			checkpoint->failed = true;
+		}
+	} else if (fwrite(data, size, 1, checkpoint->file) != 1) {
+		checkpoint->failed = true;
+	}
+}
+
+/**
+ * Processes are referred to by their indexes plus 1, and NULL by 0
+ */
+void checkpoint_process(struct checkpoint *checkpoint, struct process **pp)
+{
+	uint64_t index = 0;
+
+	if (!checkpoint->restoring) {
+		if (*pp) index = (*pp)->__checkpoint_id + 1;
+		checkpoint_value(checkpoint, index);
+		return;
+	}
+
+	checkpoint_value(checkpoint, index);
+	if (index > checkpoint->nr_processes) {
+		checkpoint->failed = true;
+		index = 0;
+	}
+	*pp = index ? checkpoint->processes[index - 1] : NULL;
+}
+
+void __checkpoint_list(struct checkpoint *checkpoint, struct list_head *head,
+		size_t offset)
+{
+	struct list_head *pos;
+	uint64_t nr = 0;
+
+	if (!checkpoint->restoring) {
+		list_for_each(pos, head) nr++;
+		checkpoint_value(checkpoint, nr);
+
+		list_for_each(pos, head) {
+			struct process *p = (struct process *)((char *)pos - offset);
+
+			checkpoint_process(checkpoint, &p);
+		}
+		return;
+	}
+
+	checkpoint_value(checkpoint, nr);
+	for (uint64_t i = 0; i < nr && !checkpoint->failed; i++) {
+		struct process *p;
+
+		checkpoint_process(checkpoint, &p);
+		if (!p) {
+			checkpoint->failed = true;
+			break;
+		}
+		list_add_tail((struct list_head *)((char *)p + offset), head);
+	}
+}
+
+static char *__temporary_name(const char *filename)
+{
+	char *name = malloc(strlen(filename) + sizeof(".tmp"));
+
+	if (name) sprintf(name, "%s.tmp", filename);
+	return name;
+}
+
+bool checkpoint_open(struct checkpoint *checkpoint, const char *filename,
+		bool restoring)
+{
+	memset(checkpoint, 0x00, sizeof(*checkpoint));
+	checkpoint->restoring = restoring;
+
+	if (restoring) {
+		checkpoint->file = fopen(filename, "rb");
+	} else {
+		char *name = __temporary_name(filename);
+
+		if (name) checkpoint->file = fopen(name, "wb");
+		free(name);
+	}
+	return !!checkpoint->file;
+}
+
+bool checkpoint_close(struct checkpoint *checkpoint, const char *filename)
+{
+	bool ok = !checkpoint->failed;
+
+	if (checkpoint->restoring) {
+		/* Everything should have been consumed */
+		if (ok && fgetc(checkpoint->file) != EOF) ok = false;
+		fclose(checkpoint->file);
+	} else {
+		char *name = __temporary_name(filename);
+
+		if (fclose(checkpoint->file)) ok = false;
+		if (ok && (!name || rename(name, filename))) ok = false;
+		if (!ok && name) remove(name);
+		free(name);
+	}
+
+	free(checkpoint->processes);
+	checkpoint->processes = NULL;
+	checkpoint->file = NULL;
+	return ok;
+}
@@ -0,0 +1,129 @@
+/**********************************************************************
+ * Copyright (c) 2019
+ *  Sang-Hoon Kim <sanghoonkim@ajou.ac.kr>
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License version 2 as
+ * published by the Free Software Foundation.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTIABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+ * GNU General Public License for more details.
+ *
+ **********************************************************************/
+
+#ifndef __CHECKPOINT_H__
+#define __CHECKPOINT_H__
+
+#include <stdio.h>
+#include <stdint.h>
+#include <stddef.h>
+
+#include "types.h"
+
+struct process;
+struct list_head;
+
+/**
+ * Snapshot of a simulation made with --checkpoint and resumed with --resume.
+ * Like the workload image, it is written in the byte order of the machine
+ * that made it;
+ *
+ *   struct checkpoint_header
+ *   the state of the framework
+ *   the state of the scheduler, written by scheduler.serialize()
+ *
+ * Processes are written once in the state of the framework, and are referred
+ * to by their indexes afterwards. The processes that are not fetched from the
+ * workload yet are not in the checkpoint, so the same script or image should
+ * be given to resume the simulation.
+ */
+#define CHECKPOINT_MAGIC		"SCHEDCK"
+#define CHECKPOINT_VERSION		2
+#define CHECKPOINT_BYTE_ORDER	0x01020304
+
+#define CHECKPOINT_STREAMING	0x1		/* Made with -l */
+#define CHECKPOINT_METRICS		0x2		/* Made with -m */
+#define CHECKPOINT_PROFILE		0x4		/* Made with -R */
+#define CHECKPOINT_PRECOMPILED	0x8		/* Made with a workload image */
+
+struct checkpoint_header {
+	char magic[8];
+	uint32_t version;
+	uint32_t byte_order;	/* CHECKPOINT_BYTE_ORDER in the maker's order */
+	char scheduler[64];		/* Name of the scheduler */
+	uint64_t script_size;	/* Size of the script or the image */
+	uint32_t ticks;
+	uint32_t nr_cpus;
+	uint32_t flags;
+	uint32_t reserved;
+};
+
+/**
+ * A checkpoint being saved or restored. The same serialize function saves
+ * and restores the state with the helpers below, which write the values when
+ * saving and overwrite them when restoring.
+ */
+struct checkpoint {
+	FILE *file;
+	bool restoring;
+	bool failed;					/* I/O error or corrupted checkpoint */
+
+	struct process **processes;		/* Processes by their indexes */
+	unsigned long nr_processes;
+};
+
+
+/***********************************************************************
+ * checkpoint_data() / checkpoint_value()
+ *
+ * DESCRIPTION
+ *   Save or restore @size bytes at @data. checkpoint_value() does the same
+ *   for a variable or a field.
+ */
+void checkpoint_data(struct checkpoint *checkpoint, void *data, size_t size);
+
+#define checkpoint_value(checkpoint, var) \
+	checkpoint_data((checkpoint), &(var), sizeof(var))
+
+
+/***********************************************************************
+ * checkpoint_process()
+ *
+ * DESCRIPTION
+ *   Save or restore the reference to the process at *@pp, which can be NULL.
+ */
+void checkpoint_process(struct checkpoint *checkpoint, struct process **pp);
+
+
+/***********************************************************************
+ * checkpoint_list()
+ *
+ * DESCRIPTION
+ *   Save or restore the processes in the list @head linked through @member
+ *   of struct process, in the order of the list. @head should be empty when
+ *   restoring.
+ */
+void __checkpoint_list(struct checkpoint *checkpoint, struct list_head *head,
+		size_t offset);
+
+#define checkpoint_list(checkpoint, head, member) \
+	__checkpoint_list((checkpoint), (head), offsetof(struct process, member))
+
+
+/***********************************************************************
+ * checkpoint_open() / checkpoint_close()
+ *
+ * DESCRIPTION
+ *   Open @filename to save into if @restoring is false, or to restore from
+ *   otherwise. checkpoint_close() returns false if anything went wrong with
+ *   the checkpoint. A checkpoint being saved is written into a temporary
+ *   file which replaces @filename only on success, so the previous checkpoint
+ *   survives a crash in the middle of saving.
+ */
+bool checkpoint_open(struct checkpoint *checkpoint, const char *filename,
+		bool restoring);
+bool checkpoint_close(struct checkpoint *checkpoint, const char *filename);
+
+#endif
@@ -0,0 +1,311 @@
+/**********************************************************************
+ * Copyright (c) 2019
+ *  Sang-Hoon Kim <sanghoonkim@ajou.ac.kr>
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License version 2 as
+ * published by the Free Software Foundation.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTIABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+ * GNU General Public License for more details.
+ *
+ **********************************************************************/
+
+/**
+ * Generate a synthetic process script for sched. The processes are printed
+ * in the order of their start time, so the script can be streamed (-l).
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <math.h>
+#include <unistd.h>
+#include <getopt.h>
+
+#include "types.h"
+#include "list_head.h"
+#include "process.h"
+#include "resource.h"
+
+#define MAX_NR_PRIOS		16
+#define MAX_LIFESPAN		1000000000.0
+#define PARETO_ALPHA		1.5
+
+enum arrival {
+	ARRIVAL_POISSON,	/* Exponential inter-arrival times */
+	ARRIVAL_BURSTY,		/* Poisson arrivals of geometric-sized bursts */
+};
+
+enum lifespan {
+	LIFESPAN_EXPONENTIAL,
+	LIFESPAN_PARETO,	/* Heavy-tailed with the shape PARETO_ALPHA */
+};
+
+static struct {
+	unsigned int prio;
+	unsigned int weight;
+} __prios[MAX_NR_PRIOS] = {
+	{ 0, 1 },
+};
+static unsigned int __nr_prios = 1;
+static unsigned int __total_weight = 1;
+
+/**
+ * xorshift64* so that the same seed generates the same script everywhere
+ */
+static unsigned long long __rng_state;
+
+static void __seed(unsigned long long seed)
+{
+	__rng_state = seed * 0x9E3779B97F4A7C15ULL + 1;
+}
+
+static unsigned long long __random(void)
+{
+	__rng_state ^= __rng_state >> 12;
+	__rng_state ^= __rng_state << 25;
+	__rng_state ^= __rng_state >> 27;
+	return __rng_state * 0x2545F4914F6CDD1DULL;
+}
+
+/* Uniform in [0, 1) */
+static double __uniform(void)
+{
+	return (__random() >> 11) * (1.0 / (1ULL << 53));
+}
+
+/* Uniform in [from, to] */
+static unsigned int __between(unsigned int from, unsigned int to)
+{
+	return from + __random() % ((unsigned long long)to - from + 1);
+}
+
+static double __exponential(double mean)
+{
+	return -mean * log(1.0 - __uniform());
+}
+
+static double __pareto(double mean)
+{
+	double scale = mean * (PARETO_ALPHA - 1) / PARETO_ALPHA;
+
+	return scale / pow(1.0 - __uniform(), 1.0 / PARETO_ALPHA);
+}
+
+static unsigned int __pick_prio(void)
+{
+	unsigned int w = __between(0, __total_weight - 1);
+
+	for (unsigned int i = 0; i < __nr_prios; i++) {
+		if (w < __prios[i].weight) return __prios[i].prio;
+		w -= __prios[i].weight;
+	}
+	return __prios[__nr_prios - 1].prio;
+}
+
+/**
+ * Parse the priority mix given as "prio:weight,prio:weight,..."
+ */
+static bool __parse_prios(char *mix)
+{
+	char *token;
+
+	__nr_prios = 0;
+	__total_weight = 0;
+
+	for (token = strtok(mix, ","); token; token = strtok(NULL, ",")) {
+		char *weight = strchr(token, ':');
+		int prio = atoi(token);
+
+		if (__nr_prios == MAX_NR_PRIOS || prio < 0 || prio >= MAX_PRIO) {
+			return false;
+		}
+		__prios[__nr_prios].prio = prio;
+		__prios[__nr_prios].weight = weight ? atoi(weight + 1) : 1;
+		__total_weight += __prios[__nr_prios].weight;
+		__nr_prios++;
+	}
+	return __nr_prios > 0 && __total_weight > 0;
+}
+
+/**
+ * Print @nr acquisitions for a process living for @lifespan ticks. The
+ * acquisitions either follow one another, or are nested in the increasing
+ * order of the resource id. A process never waits for a resource while
+ * holding a higher one, so the generated scripts are free of deadlocks.
+ */
+static void __print_acquisitions(unsigned int lifespan, unsigned int nr,
+		unsigned int nr_resources, bool nested)
+{
+	unsigned int at = 0, end = lifespan;
+
+	if (nested) {
+		unsigned int resource_id = 0;
+
+		if (nr > nr_resources) nr = nr_resources;
+
+		for (unsigned int i = 0; i < nr; i++) {
+			/* Leave room for the remaining ones above */
+			resource_id = __between(resource_id, nr_resources - (nr - i));
+			at = __between(at, end - 1);
+			end = __between(at + 1, end);
+
+			printf("\tacquire %u %u %u\n", resource_id, at, end - at);
+			resource_id++;
+		}
+		return;
+	}
+
+	for (unsigned int i = 0; i < nr && at < lifespan; i++) {
+		unsigned int resource_id = __between(0, nr_resources - 1);
+
+		at = __between(at, at + (lifespan - at - 1) / (nr - i));
+		end = __between(at + 1, at + 1 + (lifespan - at - 1) / (nr - i));
+
+		printf("\tacquire %u %u %u\n", resource_id, at, end - at);
+		at = end;
+	}
+}
+
+static void __print_usage(char * const name)
+{
+	printf("Usage: %s {-s seed} {-n N} {-a poisson|bursty} {-i N} {-b N}\n", name);
+	printf("          {-l exponential|pareto} {-m N} {-p prio:weight,...}\n");
+	printf("          {-c N} {-r N} {-k N} {-N}\n");
+	printf("\n");
+	printf("  -s: Seed the random number generator (1 by default)\n");
+	printf("  -n: Generate N processes (10 by default)\n");
+	printf("  -a: Arrival process (poisson by default)\n");
+	printf("  -i: Mean inter-arrival time in ticks (5 by default)\n");
+	printf("  -b: Mean burst size of the bursty arrivals (8 by default)\n");
+	printf("  -l: Lifespan distribution (exponential by default)\n");
+	printf("  -m: Mean lifespan in ticks (10 by default)\n");
+	printf("  -p: Priority mix; prio with its relative weight (0 by default)\n");
+	printf("  -c: Make N%% of processes acquire resources (0 by default)\n");
+	printf("  -r: Contend for N resources (%d by default)\n", NR_RESOURCES);
+	printf("  -k: Acquire up to N resources per process (2 by default)\n");
+	printf("  -N: Nest the acquisitions instead of serializing them\n\n");
+}
+
+int main(int argc, char * const argv[])
+{
+	int opt;
+	unsigned long long seed = 1;
+	unsigned int nr_processes = 10;
+	enum arrival arrival = ARRIVAL_POISSON;
+	double interarrival = 5;
+	double burst = 8;
+	enum lifespan lifespan = LIFESPAN_EXPONENTIAL;
+	double mean_lifespan = 10;
+	unsigned int contention = 0;
+	unsigned int nr_resources = NR_RESOURCES;
+	unsigned int max_acquisitions = 2;
+	bool nested = false;
+	double now = 0;
+	unsigned int nr_burst = 0;
+
+	while ((opt = getopt(argc, argv, "s:n:a:i:b:l:m:p:c:r:k:Nh")) != -1) {
+		switch (opt) {
+		case 's':
+			seed = strtoull(optarg, NULL, 0);
+			break;
+		case 'n':
+			nr_processes = atoi(optarg);
+			break;
+		case 'a':
+			if (strcmp(optarg, "poisson") == 0) {
+				arrival = ARRIVAL_POISSON;
+			} else if (strcmp(optarg, "bursty") == 0) {
+				arrival = ARRIVAL_BURSTY;
+			} else {
+				__print_usage(argv[0]);
+				return EXIT_FAILURE;
+			}
+			break;
+		case 'i':
+			interarrival = atof(optarg);
+			break;
+		case 'b':
+			burst = atof(optarg);
+			break;
+		case 'l':
+			if (strcmp(optarg, "exponential") == 0) {
+				lifespan = LIFESPAN_EXPONENTIAL;
+			} else if (strcmp(optarg, "pareto") == 0) {
+				lifespan = LIFESPAN_PARETO;
+			} else {
+				__print_usage(argv[0]);
+				return EXIT_FAILURE;
+			}
+			break;
+		case 'm':
+			mean_lifespan = atof(optarg);
+			break;
+		case 'p':
+			if (!__parse_prios(optarg)) {
+				__print_usage(argv[0]);
+				return EXIT_FAILURE;
+			}
+			break;
+		case 'c':
+			contention = atoi(optarg);
+			break;
+		case 'r':
+			nr_resources = atoi(optarg);
+			break;
+		case 'k':
+			max_acquisitions = atoi(optarg);
+			break;
+		case 'N':
+			nested = true;
+			break;
+		case 'h':
+		default:
+			__print_usage(argv[0]);
+			return EXIT_FAILURE;
+		}
+	}
+
+	if (interarrival < 0 || burst < 1 || mean_lifespan < 1 || contention > 100 ||
+			nr_resources < 1 || max_acquisitions < 1) {
+		__print_usage(argv[0]);
+		return EXIT_FAILURE;
+	}
+
+	__seed(seed);
+
+	for (unsigned int pid = 1; pid <= nr_processes; pid++) {
+		double length;
+		unsigned int ticks;
+
+		/* Arrive at the next tick */
+		if (arrival == ARRIVAL_POISSON) {
+			now += __exponential(interarrival);
+		} else if (nr_burst == 0) {
+			/* A new burst of geometric size, keeping the mean arrival rate */
+			now += __exponential(interarrival * burst);
+			nr_burst = 1 + (unsigned int)(log(1.0 - __uniform()) / log(1.0 - 1.0 / burst));
+		}
+		if (nr_burst) nr_burst--;
+
+		length = lifespan == LIFESPAN_PARETO ?
+				__pareto(mean_lifespan) : __exponential(mean_lifespan);
+		if (length > MAX_LIFESPAN) length = MAX_LIFESPAN;
+		ticks = length < 1 ? 1 : (unsigned int)(length + 0.5);
+
+		printf("process %u\n", pid);
+		printf("\tstart %u\n", (unsigned int)now);
+		printf("\tlifespan %u\n", ticks);
+		printf("\tprio %u\n", __pick_prio());
+		if (__between(1, 100) <= contention) {
+			__print_acquisitions(ticks, __between(1, max_acquisitions),
+					nr_resources, nested);
+		}
+		printf("end\n\n");
+	}
+
+	return EXIT_SUCCESS;
+}
@@ -0,0 +1,148 @@
+/**********************************************************************
+ * Copyright (c) 2019
+ *  Sang-Hoon Kim <sanghoonkim@ajou.ac.kr>
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License version 2 as
+ * published by the Free Software Foundation.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTIABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+ * GNU General Public License for more details.
+ *
+ **********************************************************************/
+
+#ifndef __HEAP_H__
+#define __HEAP_H__
+
+#include <stdlib.h>
+#include <assert.h>
+
+#include "types.h"
+#include "process.h"
+#include "checkpoint.h"
+
+/**
+ * Binary min-heap of processes. Processes are ordered by @key, and the ones
+ * with the same @key are ordered by the time they were pushed so that the
+ * heap picks processes in the same order as a scan over a FIFO list does.
+ */
+struct heap_entry {
+	unsigned long long key;
+	unsigned long seq;
+	struct process *process;
+};
+
+struct heap {
+	unsigned int nr;			/* # of processes in the heap */
+	unsigned int size;			/* # of allocated entries */
+	unsigned long seq;			/* Sequence number for the next push */
+	struct heap_entry *entries;
+};
+
+static inline void heap_init(struct heap *heap)
+{
+	heap->nr = heap->size = 0;
+	heap->seq = 0;
+	heap->entries = NULL;
+}
+
+static inline void heap_free(struct heap *heap)
+{
+	free(heap->entries);
+	heap_init(heap);
+}
+
+static inline bool heap_empty(struct heap *heap)
+{
+	return heap->nr == 0;
+}
+
+static inline bool __heap_less(struct heap_entry *a, struct heap_entry *b)
+{
+	return a->key < b->key || (a->key == b->key && a->seq < b->seq);
+}
+
+/**
+ * The entry with the smallest key. Do not call on an empty heap.
+ */
+static inline struct heap_entry *heap_top(struct heap *heap)
+{
+	assert(heap->nr);
+	return heap->entries;
+}
+
+static inline void heap_push(struct heap *heap, struct process *p, unsigned long long key)
+{
+	struct heap_entry e = { .key = key, .seq = heap->seq++, .process = p };
+	unsigned int i;
+
+	if (heap->nr == heap->size) {
+		heap->size = heap->size ? heap->size * 2 : 64;
+		heap->entries = realloc(heap->entries, sizeof(*heap->entries) * heap->size);
+		assert(heap->entries);
+	}
+
+	for (i = heap->nr++; i > 0; i = (i - 1) / 2) {
+		struct heap_entry *parent = heap->entries + (i - 1) / 2;
+		if (!__heap_less(&e, parent)) break;
+		heap->entries[i] = *parent;
+	}
+	heap->entries[i] = e;
+}
+
+/**
+ * Take out the process with the smallest key. NULL if the heap is empty.
+ */
+static inline struct process *heap_pop(struct heap *heap)
+{
+	struct process *p;
+	struct heap_entry last;
+	unsigned int i, child;
+
+	if (!heap->nr) return NULL;
+
+	p = heap->entries[0].process;
+	last = heap->entries[--heap->nr];
+
+	for (i = 0; (child = 2 * i + 1) < heap->nr; i = child) {
+		if (child + 1 < heap->nr &&
+				__heap_less(heap->entries + child + 1, heap->entries + child)) {
+			child++;
+		}
+		if (!__heap_less(heap->entries + child, &last)) break;
+		heap->entries[i] = heap->entries[child];
+	}
+	heap->entries[i] = last;
+
+	return p;
+}
+
+/**
+ * Save or restore @heap as it is. @heap should be initialized when restoring
+ */
+static inline void heap_serialize(struct heap *heap, struct checkpoint *checkpoint)
+{
+	checkpoint_value(checkpoint, heap->nr);
+	checkpoint_value(checkpoint, heap->size);
+	checkpoint_value(checkpoint, heap->seq);
+
+	if (checkpoint->restoring) {
+		if (checkpoint->failed || heap->nr > heap->size) {
+			checkpoint->failed = true;
+			heap->nr = heap->size = 0;
+			return;
+		}
+		heap->entries = realloc(heap->entries, sizeof(*heap->entries) * heap->size);
+		assert(heap->entries || !heap->size);
+	}
+
+	for (unsigned int i = 0; i < heap->nr; i++) {
+		checkpoint_value(checkpoint, heap->entries[i].key);
+		checkpoint_value(checkpoint, heap->entries[i].seq);
+		checkpoint_process(checkpoint, &heap->entries[i].process);
+	}
+}
+
+#endif
@@ -0,0 +1,253 @@
+/**********************************************************************
+ * Copyright (c) 2019
+ *  Sang-Hoon Kim <sanghoonkim@ajou.ac.kr>
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License version 2 as
+ * published by the Free Software Foundation.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTIABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+ * GNU General Public License for more details.
+ *
+ **********************************************************************/
+
+#ifdef CONFIG_INSTRUMENT
+
+#include <stdio.h>
+#include <string.h>
+#include <time.h>
+
+#include "types.h"
+#include "list_head.h"
+#include "process.h"
+#include "sched.h"
+#include "instrument.h"
+
+extern __thread struct list_head readyqueue;
+
+enum instrument_callback {
+	INSTRUMENT_SCHEDULE,
+	INSTRUMENT_ACQUIRE,
+	INSTRUMENT_RELEASE,
+	INSTRUMENT_ACQUIRE_SHARED,
+	INSTRUMENT_RELEASE_SHARED,
+	INSTRUMENT_FORKED,
+	INSTRUMENT_EXITING,
+	INSTRUMENT_NR_READY,
+	INSTRUMENT_BALANCE,
+	NR_INSTRUMENT_CALLBACKS,
+};
+
+static const char *__callback_names[] = {
+	"schedule",
+	"acquire",
+	"release",
+	"acquire_shared",
+	"release_shared",
+	"forked",
+	"exiting",
+	"nr_ready",
+	"balance",
+};
+
+#define NR_HISTOGRAM_BUCKETS	64	/* Bucket b counts [2^(b-1), 2^b) cycles */
+
+static __thread struct {
+	unsigned long nr_calls;
+	unsigned long long cycles;
+	unsigned long histogram[NR_HISTOGRAM_BUCKETS];
+} __counters[NR_INSTRUMENT_CALLBACKS];
+
+/**
+ * # of ready processes schedule() could examine; those in @readyqueue and
+ * those in the policy's own data structure.
+ */
+static __thread unsigned long long __nr_examined;
+static __thread unsigned long __max_examined;
+
+static __thread struct scheduler *__sched;	/* The instrumented one */
+static __thread struct scheduler __wrapper;
+
+static inline unsigned long long __cycles(void)
+{
+#if defined(__x86_64__) || defined(__i386__)
+	return __builtin_ia32_rdtsc();
+#else
+	struct timespec ts;
+
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+	return ts.tv_sec * 1000000000ULL + ts.tv_nsec;
+#endif
+}
+
+static inline void __account(enum instrument_callback callback, unsigned long long start)
+{
+	unsigned long long cycles = __cycles() - start;
+
+	__counters[callback].nr_calls++;
+	__counters[callback].cycles += cycles;
+	__counters[callback].histogram[cycles ? 64 - __builtin_clzll(cycles) : 0]++;
+}
+
+static struct process *__instrument_schedule(void)
+{
+	struct list_head *l;
+	unsigned long nr = 0;
+	unsigned long long start;
+	struct process *next;
+
+	list_for_each(l, &readyqueue) {
+		nr++;
+	}
+	if (__sched->nr_ready) nr += __sched->nr_ready();
+
+	__nr_examined += nr;
+	if (nr > __max_examined) __max_examined = nr;
+
+	start = __cycles();
+	next = __sched->schedule();
+	__account(INSTRUMENT_SCHEDULE, start);
+
+	return next;
+}
+
+static bool __instrument_acquire(int resource_id)
+{
+	unsigned long long start = __cycles();
+	bool ret = __sched->acquire(resource_id);
+
+	__account(INSTRUMENT_ACQUIRE, start);
+	return ret;
+}
+
+static void __instrument_release(int resource_id)
+{
+	unsigned long long start = __cycles();
+
+	__sched->release(resource_id);
+	__account(INSTRUMENT_RELEASE, start);
+}
+
+static bool __instrument_acquire_shared(int resource_id)
+{
+	unsigned long long start = __cycles();
+	bool ret = __sched->acquire_shared(resource_id);
+
+	__account(INSTRUMENT_ACQUIRE_SHARED, start);
+	return ret;
+}
+
+static void __instrument_release_shared(int resource_id)
+{
+	unsigned long long start = __cycles();
+
+	__sched->release_shared(resource_id);
+	__account(INSTRUMENT_RELEASE_SHARED, start);
+}
+
+static void __instrument_forked(struct process *p)
+{
+	unsigned long long start = __cycles();
+
+	__sched->forked(p);
+	__account(INSTRUMENT_FORKED, start);
+}
+
+static void __instrument_exiting(struct process *p)
+{
+	unsigned long long start = __cycles();
+
+	__sched->exiting(p);
+	__account(INSTRUMENT_EXITING, start);
+}
+
+static unsigned int __instrument_nr_ready(void)
+{
+	unsigned long long start = __cycles();
+	unsigned int nr = __sched->nr_ready();
+
+	__account(INSTRUMENT_NR_READY, start);
+	return nr;
+}
+
+static void __instrument_balance(void)
+{
+	unsigned long long start = __cycles();
+
+	__sched->balance();
+	__account(INSTRUMENT_BALANCE, start);
+}
+
+struct scheduler *instrument_scheduler(struct scheduler *sched)
+{
+	memset(__counters, 0x00, sizeof(__counters));
+	__nr_examined = 0;
+	__max_examined = 0;
+
+	__sched = sched;
+	__wrapper = *sched;
+
+	/* Leave the callbacks not implemented NULL as the framework checks them */
+	if (sched->schedule) __wrapper.schedule = __instrument_schedule;
+	if (sched->acquire) __wrapper.acquire = __instrument_acquire;
+	if (sched->release) __wrapper.release = __instrument_release;
+	if (sched->acquire_shared) __wrapper.acquire_shared = __instrument_acquire_shared;
+	if (sched->release_shared) __wrapper.release_shared = __instrument_release_shared;
+	if (sched->forked) __wrapper.forked = __instrument_forked;
+	if (sched->exiting) __wrapper.exiting = __instrument_exiting;
+	if (sched->nr_ready) __wrapper.nr_ready = __instrument_nr_ready;
+	if (sched->balance) __wrapper.balance = __instrument_balance;
+
+	return &__wrapper;
+}
+
+void instrument_report(FILE *file)
+{
+	unsigned long nr_schedules = __counters[INSTRUMENT_SCHEDULE].nr_calls;
+	int first = NR_HISTOGRAM_BUCKETS, last = 0;
+
+	fprintf(file, "\n");
+	fprintf(file, "***** INSTRUMENTATION *********\n");
+	fprintf(file, "callback              calls         cycles  cycles/call\n");
+	for (int i = 0; i < NR_INSTRUMENT_CALLBACKS; i++) {
+		if (!__counters[i].nr_calls) continue;
+
+		fprintf(file, "%-14s %12lu %14llu %12.1f\n", __callback_names[i],
+				__counters[i].nr_calls, __counters[i].cycles,
+				(double)__counters[i].cycles / __counters[i].nr_calls);
+
+		for (int b = 0; b < NR_HISTOGRAM_BUCKETS; b++) {
+			if (!__counters[i].histogram[b]) continue;
+			if (b < first) first = b;
+			if (b > last) last = b;
+		}
+	}
+
+	fprintf(file, "\n");
+	fprintf(file, "schedule() examined %.2f ready processes per call (max %lu)\n",
+			nr_schedules ? (double)__nr_examined / nr_schedules : 0.0,
+			__max_examined);
+
+	if (first > last) return;
+
+	fprintf(file, "\n");
+	fprintf(file, "cycles/call  ");
+	for (int i = 0; i < NR_INSTRUMENT_CALLBACKS; i++) {
+		if (__counters[i].nr_calls) fprintf(file, " %14s", __callback_names[i]);
+	}
+	fprintf(file, "\n");
+
+	for (int b = first; b <= last; b++) {
+		fprintf(file, "< %-10llu ", 1ULL << b);
+		for (int i = 0; i < NR_INSTRUMENT_CALLBACKS; i++) {
+			if (__counters[i].nr_calls) {
+				fprintf(file, " %14lu", __counters[i].histogram[b]);
+			}
+		}
+		fprintf(file, "\n");
+	}
+}
+
+#endif
@@ -0,0 +1,59 @@
+/**********************************************************************
+ * Copyright (c) 2019
+ *  Sang-Hoon Kim <sanghoonkim@ajou.ac.kr>
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License version 2 as
+ * published by the Free Software Foundation.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTIABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+ * GNU General Public License for more details.
+ *
+ **********************************************************************/
+
+#ifndef __INSTRUMENT_H__
+#define __INSTRUMENT_H__
+
+#include <stdio.h>
+
+struct scheduler;
+
+#ifdef CONFIG_INSTRUMENT
+
+/***********************************************************************
+ * instrument_scheduler()
+ *
+ * DESCRIPTION
+ *   Wrap the callbacks of @sched to count the calls and the cycles spent in
+ *   them. Return the scheduler to use in place of @sched. The counters are
+ *   thread-local and reset on every call.
+ */
+struct scheduler *instrument_scheduler(struct scheduler *sched);
+
+
+/***********************************************************************
+ * instrument_report()
+ *
+ * DESCRIPTION
+ *   Print the counters and the cycle histograms into @file.
+ */
+void instrument_report(FILE *file);
+
+#else
+
+/* Instrumentation is compiled out. Build with "make INSTRUMENT=1" for it */
+static inline struct scheduler *instrument_scheduler(struct scheduler *sched)
+{
+	return sched;
+}
+
+static inline void instrument_report(FILE *file)
+{
+	(void)file;
+}
+
+#endif
+
+#endif
@@ -18,33 +18,57 @@
 #include <stdio.h>
 #include <stdlib.h>
 #include <assert.h>
+#include <limits.h>
 
 #include "types.h"
 #include "list_head.h"
+#include "rbtree.h"
+#include "checkpoint.h"
 
 /**
  * The process which is currently running
  */
 #include "process.h"
-extern struct process *current;
+extern __thread struct process *current;
 
 /**
  * List head to hold the processes ready to run
  */
-extern struct list_head readyqueue;
+extern __thread struct list_head readyqueue;
 
 
 /**
  * Resources in the system.
  */
 #include "resource.h"
-extern struct resource resources[NR_RESOURCES];
+extern __thread struct resource *resources;
+extern __thread unsigned int nr_resources;
 
 
 /**
  * Monotonically increasing ticks
  */
-extern unsigned int ticks;
+extern __thread unsigned int ticks;
+
+
+/**
+ * Number of CPUs in the system, and the CPU the callbacks are called for
+ */
+#include "sched.h"
+extern unsigned int nr_cpus;
+extern __thread unsigned int this_cpu;
+
+
+/**
+ * Ticks to take for migrating a process to another CPU
+ */
+extern unsigned int migration_cost;
+
+
+/**
+ * Ticks in a time slice of the round-robin and priority schedulers
+ */
+extern unsigned int quantum;
 
 
 /**
@@ -53,6 +77,63 @@ extern unsigned int ticks;
 extern bool quiet;
 
 
+/***********************************************************************
+ * Resource helpers
+ *
+ * DESCRIPTION
+ *   resource_take() lets @current take @r if available, in the shared mode if
+ *   @shared. Mutexes and rwlocks taken exclusively get @current as @owner.
+ *   Semaphores and rwlocks taken in the shared mode are not owned by anyone,
+ *   and @nr_holders kept by the framework tells how many processes hold them.
+ *
+ *   resource_wakeable() tells whether @waiter would get @r if it is woken up
+ *   after @nr_woken waiters. Waking up stops after a waiter that is to hold
+ *   @r exclusively, so a released rwlock goes to either one writer or all the
+ *   readers at the head of the waitqueue.
+ ***********************************************************************/
+static bool resource_take(struct resource *r, bool shared)
+{
+	switch (r->kind) {
+	case RESOURCE_SEMAPHORE:
+		return r->nr_holders < r->capacity;
+	case RESOURCE_RWLOCK:
+		if (shared) return !r->owner;
+		if (r->nr_holders) return false;
+		/* Fall through */
+	default:
+		if (r->owner) return false;
+		r->owner = current;
+		return true;
+	}
+}
+
+static void resource_put(struct resource *r, bool shared)
+{
+	if (r->kind == RESOURCE_SEMAPHORE || shared) return;
+
+	/* Ensure that the owner process is releasing the resource */
+	assert(r->owner == current);
+	r->owner = NULL;
+}
+
+static bool resource_exclusive(struct resource *r, bool shared)
+{
+	return r->kind == RESOURCE_MUTEX || (r->kind == RESOURCE_RWLOCK && !shared);
+}
+
+static bool resource_wakeable(struct resource *r, struct process *waiter,
+		unsigned int nr_woken)
+{
+	if (r->kind == RESOURCE_SEMAPHORE) {
+		return r->nr_holders + nr_woken < r->capacity;
+	}
+	if (r->owner) return false;
+	if (resource_exclusive(r, waiter->blocked_shared)) {
+		return !r->nr_holders && !nr_woken;
+	}
+	return true;
+}
+
 /***********************************************************************
  * Default FCFS resource acquision function
  *
@@ -62,20 +143,20 @@ extern bool quiet;
  *   The current implementation serves the resource in the requesting order
  *   without considering the priority. See the comments in sched.h
  ***********************************************************************/
-bool fcfs_acquire(int resource_id)
+static bool __fcfs_acquire(int resource_id, bool shared)
 {
 	struct resource *r = resources + resource_id;
 
-	if (!r->owner) {
-		/* This resource is not owned by any one. Take it! */
-		r->owner = current;
+	if (resource_take(r, shared)) {
+		/* This resource is available. Take it! */
 		return true;
 	}
 
-	/* OK, this resource is taken by @r->owner. */
+	/* OK, this resource is taken by others. */
 
 	/* Update the current process state */
 	current->status = PROCESS_WAIT;
+	current->blocked_shared = shared;
 
 	/* And append current to waitqueue */
 	list_add_tail(&current->list, &r->waitqueue);
@@ -88,6 +169,16 @@ bool fcfs_acquire(int resource_id)
 	return false;
 }
 
+bool fcfs_acquire(int resource_id)
+{
+	return __fcfs_acquire(resource_id, false);
+}
+
+bool fcfs_acquire_shared(int resource_id)
+{
+	return __fcfs_acquire(resource_id, true);
+}
+
 /***********************************************************************
  * Default FCFS resource release function
  *
@@ -97,20 +188,18 @@ bool fcfs_acquire(int resource_id)
  *   The current implementation serves the resource in the requesting order
  *   without considering the priority. See the comments in sched.h
  ***********************************************************************/
-void fcfs_release(int resource_id)
+static void __fcfs_release(int resource_id, bool shared)
 {
 	struct resource *r = resources + resource_id;
-
-	/* Ensure that the owner process is releasing the resource */
-	assert(r->owner == current);
+	struct process *waiter, *tmp;
+	unsigned int nr_woken = 0;
 
 	/* Un-own this resource */
-	r->owner = NULL;
+	resource_put(r, shared);
 
-	/* Let's wake up ONE waiter (if exists) that came first */
-	if (!list_empty(&r->waitqueue)) {
-		struct process *waiter =
-				list_first_entry(&r->waitqueue, struct process, list);
+	/* Let's wake up the waiters that came first and can take the resource */
+	list_for_each_entry_safe(waiter, tmp, &r->waitqueue, list) {
+		if (!resource_wakeable(r, waiter, nr_woken)) break;
 
 		/**
 		 * Ensure the waiter  is in the wait status
@@ -129,16 +218,27 @@ void fcfs_release(int resource_id)
 		waiter->status = PROCESS_READY;
 
 		/**
-		 * Put the waiter process into ready queue. The framework will
-		 * do the rest.
+		 * Put the waiter process into the ready queue of its CPU. The
+		 * framework will do the rest.
 		 */
-		list_add_tail(&waiter->list, &readyqueue);
+		list_add_tail(&waiter->list, cpu_readyqueue(waiter->cpu));
+
+		nr_woken++;
+		if (resource_exclusive(r, waiter->blocked_shared)) break;
 	}
 }
 
+void fcfs_release(int resource_id)
+{
+	__fcfs_release(resource_id, false);
+}
+
+void fcfs_release_shared(int resource_id)
+{
+	__fcfs_release(resource_id, true);
+}
 
 
-#include "sched.h"
 
 /***********************************************************************
  * FIFO scheduler
@@ -201,8 +301,11 @@ pick_next:
 
 struct scheduler fifo_scheduler = {
 	.name = "FIFO",
+	.tickless = TICKLESS_ALWAYS,
 	.acquire = fcfs_acquire,
 	.release = fcfs_release,
+	.acquire_shared = fcfs_acquire_shared,
+	.release_shared = fcfs_release_shared,
 	.initialize = fifo_initialize,
 	.finalize = fifo_finalize,
 	.schedule = fifo_schedule,
@@ -211,11 +314,44 @@ struct scheduler fifo_scheduler = {
 
 /***********************************************************************
  * SJF scheduler
+ *
+ * Ready processes are kept in a min-heap keyed by their lifespan. Processes
+ * that became ready are collected from @readyqueue on every schedule() call,
+ * so the heap sees them in the same order as they were queued.
  ***********************************************************************/
+#include "heap.h"
+
+static __thread struct heap sjf_rq[MAX_NR_CPUS];
+
+static int sjf_initialize(void)
+{
+	for (unsigned int i = 0; i < nr_cpus; i++) {
+		heap_init(sjf_rq + i);
+	}
+	return 0;
+}
+
+static void sjf_finalize(void)
+{
+	for (unsigned int i = 0; i < nr_cpus; i++) {
+		heap_free(sjf_rq + i);
+	}
+}
+
+static unsigned int sjf_nr_ready(void)
+{
+	return sjf_rq[this_cpu].nr;
+}
+
 static struct process *sjf_schedule(void)
 {
-	struct process *next = NULL;
-	unsigned int min = 100000;
+	struct heap *rq = sjf_rq + this_cpu;
+	struct process *p, *tmp;
+
+	list_for_each_entry_safe(p, tmp, &readyqueue, list) {
+		list_del_init(&p->list);
+		heap_push(rq, p, p->lifespan);
+	}
 
 	if (!current || current->status == PROCESS_WAIT) {
 		goto pick_next;
@@ -224,72 +360,137 @@ static struct process *sjf_schedule(void)
 		return current;
 	}
 pick_next:
-	if (!list_empty(&readyqueue)) {
-		list_for_each_entry(next, &readyqueue, list) {
-			if (min > next->lifespan) min = next->lifespan;
-		}
-		list_for_each_entry(next, &readyqueue, list) {
-			if (min == next->lifespan) break;
-		}
-		list_del_init(&next->list);
+	return heap_pop(rq);
+}
+
+static void sjf_serialize(struct checkpoint *checkpoint)
+{
+	for (unsigned int i = 0; i < nr_cpus; i++) {
+		heap_serialize(sjf_rq + i, checkpoint);
 	}
-	return next;
 }
 
 struct scheduler sjf_scheduler = {
 	.name = "Shortest-Job First",
+	.tickless = TICKLESS_ALWAYS,
 	.acquire = fcfs_acquire, /* Use the default FCFS acquire() */
 	.release = fcfs_release, /* Use the default FCFS release() */
-	.schedule = sjf_schedule,		 /* TODO: Assign sjf_schedule()
-								to this function pointer to activate
-								SJF in the system */
+	.acquire_shared = fcfs_acquire_shared,
+	.release_shared = fcfs_release_shared,
+	.initialize = sjf_initialize,
+	.finalize = sjf_finalize,
+	.nr_ready = sjf_nr_ready,
+	.schedule = sjf_schedule,
+	.serialize = sjf_serialize,
 };
 
 /***********************************************************************
  * SRTF scheduler
+ *
+ * Same as SJF but keyed by the remaining time. Ready processes do not age,
+ * so their keys stay valid while they are in the heap.
  ***********************************************************************/
+static __thread struct heap srtf_rq[MAX_NR_CPUS];
+
+static int srtf_initialize(void)
+{
+	for (unsigned int i = 0; i < nr_cpus; i++) {
+		heap_init(srtf_rq + i);
+	}
+	return 0;
+}
+
+static void srtf_finalize(void)
+{
+	for (unsigned int i = 0; i < nr_cpus; i++) {
+		heap_free(srtf_rq + i);
+	}
+}
+
+static unsigned int srtf_nr_ready(void)
+{
+	return srtf_rq[this_cpu].nr;
+}
+
 static struct process *srtf_schedule(void)
 {
-	struct process *next = NULL;
-	unsigned int min = 100000;
+	struct heap *rq = srtf_rq + this_cpu;
+	struct process *p, *tmp;
 
-	if (!list_empty(&readyqueue)) {
-		list_for_each_entry(next, &readyqueue, list) {
-			if (min > (next->lifespan - next->age))
-				min = next->lifespan - next->age;
-		}
-		list_for_each_entry(next, &readyqueue, list) {
-			if (min == (next->lifespan - next->age))
-				break;
-		}
+	list_for_each_entry_safe(p, tmp, &readyqueue, list) {
+		list_del_init(&p->list);
+		heap_push(rq, p, p->lifespan - p->age);
 	}
+
 	if (!current || current->status == PROCESS_WAIT) {
 		goto pick_next;
 	}
 	if (current->age < current->lifespan) {
-		if (current->lifespan - current->age > min) {
-			list_add_tail(&current->list, &readyqueue);
+		unsigned int remaining = current->lifespan - current->age;
+
+		if (!heap_empty(rq) && heap_top(rq)->key < remaining) {
+			heap_push(rq, current, remaining);
 			goto pick_next;
 		}
 		return current;
 	}
 pick_next:
-	if (!list_empty(&readyqueue)) {
-		list_del_init(&next->list);
+	return heap_pop(rq);
+}
+
+static void srtf_serialize(struct checkpoint *checkpoint)
+{
+	for (unsigned int i = 0; i < nr_cpus; i++) {
+		heap_serialize(srtf_rq + i, checkpoint);
 	}
-	return next;
 }
+
 struct scheduler srtf_scheduler = {
 	.name = "Shortest Remaining Time First",
+	.tickless = TICKLESS_ALONE,
 	.acquire = fcfs_acquire, /* Use the default FCFS acquire() */
 	.release = fcfs_release, /* Use the default FCFS release() */
+	.acquire_shared = fcfs_acquire_shared,
+	.release_shared = fcfs_release_shared,
+	.initialize = srtf_initialize,
+	.finalize = srtf_finalize,
+	.nr_ready = srtf_nr_ready,
 	.schedule = srtf_schedule,
-	/* You need to check the newly created processes to implement SRTF.
-	 * Use @forked() callback to mark newly created processes */
-	/* Obviously, you should implement srtf_schedule() and attach it here */
+	.serialize = srtf_serialize,
 };
 
 
+/***********************************************************************
+ * Time slice helpers
+ *
+ * DESCRIPTION
+ *   A process picked to run gets a time slice of @quantum ticks, and it is
+ *   switched out for the processes of the same priority when the slice is
+ *   used up. A process running alone gets a new slice whenever the previous
+ *   one expires.
+ *
+ *   Schedulers are called on every tick while others are ready, but ticks may
+ *   be fast-forwarded while @current runs alone in the event-driven mode. The
+ *   slices that would have been renewed in the meantime are accounted when
+ *   the slice is checked, so the decision is the same in both modes.
+ ***********************************************************************/
+static inline void slice_start(struct process *p)
+{
+	p->slice_at = p->age;
+}
+
+static bool slice_expired(struct process *p)
+{
+	unsigned int elapsed = p->age - p->slice_at;
+
+	if (elapsed > quantum) {
+		elapsed = (elapsed - 1) % quantum + 1;
+		p->slice_at = p->age - elapsed;
+	}
+	return elapsed >= quantum;
+}
+
+
 /***********************************************************************
  * Round-robin scheduler
  ***********************************************************************/
@@ -299,246 +500,1571 @@ static struct process *rr_schedule(void) {
 	if (!current || current->status == PROCESS_WAIT || current->age == current->lifespan) {
 		goto pick_next;
 	}
-	if (current->age < current->lifespan && list_empty(&readyqueue)) {
+	if (!slice_expired(current)) {
 		return current;
 	}
-	if (!list_empty(&readyqueue)) {
-		list_add_tail(&current->list, &readyqueue);
-		goto pick_next;
+	if (list_empty(&readyqueue)) {
+		slice_start(current);
+		return current;
 	}
+	list_add_tail(&current->list, &readyqueue);
+
 pick_next:
 	if (!list_empty(&readyqueue)) {
 		next = list_first_entry(&readyqueue, struct process, list);
 		list_del_init(&next->list);
+		slice_start(next);
 	}
 	return next;
 }
 struct scheduler rr_scheduler = {
 	.name = "Round-Robin",
+	.tickless = TICKLESS_ALONE,
 	.acquire = fcfs_acquire, /* Use the default FCFS acquire() */
 	.release = fcfs_release, /* Use the default FCFS release() */
+	.acquire_shared = fcfs_acquire_shared,
+	.release_shared = fcfs_release_shared,
 	.schedule = rr_schedule,/* Obviously, you should implement rr_schedule() and attach it here */
 };
 
 /***********************************************************************
  * Priority scheduler
+ *
+ * Ready processes are kept in a prio_array rather than in @readyqueue so that
+ * the most important one is found without walking all the ready processes.
+ * Processes with the same priority are served in the enqueue order, so they
+ * are scheduled in the round-robin way.
+ *
+ * Likewise, the processes waiting for a resource are kept in a prio_array per
+ * resource instead of @waitqueue, so that releasing a resource wakes up the
+ * most important waiter in O(1). Waiters with the same priority are woken up
+ * in the order they got blocked. A prio_array is allocated only for the
+ * resources that have ever been contended for, so the cost scales with the
+ * contended resources rather than all the resources in the system.
  ***********************************************************************/
-static struct process *prio_schedule(void){
-	struct process *next = NULL;
-	struct process *temp;
-	unsigned int max;
-	unsigned int check=0;
-	if (!current || current->status == PROCESS_WAIT || current->age == current->lifespan) {
-		goto pick_next;
-	}
-	if (current->age < current->lifespan && list_empty(&readyqueue)) {
-		return current;
-	}
-	if (!list_empty(&readyqueue)) {
-		max = current->prio_orig;
-		list_for_each_entry(next, &readyqueue, list){
-			if(max < next->prio_orig) max = next->prio_orig;
-		}
-		list_for_each_entry(next, &readyqueue, list){
-			if(max == next->prio_orig){
-				check=1;
-				break;
-			}
-		}
-		if(check==1){
-			list_add_tail(&current->list, &readyqueue);
-			list_del_init(&next->list);
+#include "prio_array.h"
 
-		}else{
-			return current;
-		}
-	}
-	return next;
+static __thread struct prio_array prio_rq[MAX_NR_CPUS];
 
-pick_next:
-	if (!list_empty(&readyqueue)) {
-		temp = list_first_entry(&readyqueue, struct process, list);
-		max = temp->prio_orig;
+static __thread struct prio_waitqueue {
+	struct prio_array *waiters;	/* NULL until contended for */
+	struct list_head holders;	/* Holders of the resource (PIP only) */
+} *prio_wq;
 
-		list_for_each_entry(next, &readyqueue, list){
-			if(max < next->prio_orig) max = next->prio_orig;
-		}
-		list_for_each_entry(next, &readyqueue, list){
-			if(max == next->prio_orig) break;
-		}
-		list_del_init(&next->list);
+static void prio_waitqueue_init(void)
+{
+	prio_wq = malloc(sizeof(*prio_wq) * (nr_resources ? nr_resources : 1));
+	assert(prio_wq);
+
+	for (unsigned int i = 0; i < nr_resources; i++) {
+		prio_wq[i].waiters = NULL;
+		INIT_LIST_HEAD(&prio_wq[i].holders);
 	}
-	return next;
 }
 
-bool prio_acquire(int resource_id)
+static void prio_waitqueue_exit(void)
 {
-	struct resource *r = resources + resource_id;
-	if (!r->owner) {
-		r->owner = current;
-		return true;
+	for (unsigned int i = 0; i < nr_resources; i++) {
+		free(prio_wq[i].waiters);
 	}
+	free(prio_wq);
+	prio_wq = NULL;
+}
+
+/**
+ * The highest priority of the waiters in @wq. -1 if no one waits
+ */
+static int prio_waitqueue_top(struct prio_waitqueue *wq)
+{
+	return wq->waiters ? prio_array_top(wq->waiters) : -1;
+}
+
+/**
+ * Allocate the prio_array of @wq when it is contended for the first time
+ */
+static void prio_waitqueue_contend(struct prio_waitqueue *wq)
+{
+	if (wq->waiters) return;
+
+	wq->waiters = malloc(sizeof(*wq->waiters));
+	assert(wq->waiters);
+	prio_array_init(wq->waiters);
+}
+
+/**
+ * Block @current on @resource_id with priority @prio
+ */
+static void prio_waitqueue_block(int resource_id, bool shared, unsigned int prio)
+{
+	struct prio_waitqueue *wq = prio_wq + resource_id;
+
+	prio_waitqueue_contend(wq);
+
 	current->status = PROCESS_WAIT;
-	list_add_tail(&current->list, &r->waitqueue);
-	return false;
+	current->blocked_on = resources + resource_id;
+	current->blocked_shared = shared;
+	prio_array_enqueue(wq->waiters, current, prio);
 }
 
-void prio_release(int resource_id)
+/**
+ * Take out the most important waiter of @resource_id if it can take the
+ * resource after @nr_woken waiters. NULL if no one waits or if it cannot
+ */
+static struct process *prio_waitqueue_wakeup(int resource_id, unsigned int nr_woken)
 {
-	struct resource *r = resources + resource_id;
+	struct prio_array *waiters = prio_wq[resource_id].waiters;
 	struct process *p;
-	
-	unsigned int max;
-	assert(r->owner == current);
 
-	r->owner = NULL;
+	if (!waiters) return NULL;
+
+	p = prio_array_first(waiters);
+	if (!p || !resource_wakeable(resources + resource_id, p, nr_woken)) return NULL;
+
+	assert(p->status == PROCESS_WAIT);
+	prio_array_dequeue(waiters, p);
+	p->blocked_on = NULL;
+	p->status = PROCESS_READY;
+
+	return p;
+}
 
-	if (!list_empty(&r->waitqueue)) {
-		p = list_first_entry(&r->waitqueue, struct process, list);
-		max = p->prio_orig;
+/**
+ * Save or restore the waiters of the resources that have been contended for,
+ * listed by the resource id and terminated by UINT_MAX
+ */
+static void prio_waitqueue_serialize(struct checkpoint *checkpoint)
+{
+	unsigned int id;
+
+	if (!checkpoint->restoring) {
+		for (id = 0; id < nr_resources; id++) {
+			if (!prio_wq[id].waiters) continue;
 
-		list_for_each_entry(p, &r->waitqueue, list){
-			if(p->prio_orig > max) max = p->prio_orig;
+			checkpoint_value(checkpoint, id);
+			prio_array_serialize(prio_wq[id].waiters, checkpoint);
 		}
-		list_for_each_entry(p, &r->waitqueue, list){
-			if(p->prio_orig == max)
-				break;
+		id = UINT_MAX;
+		checkpoint_value(checkpoint, id);
+		return;
+	}
+
+	for (checkpoint_value(checkpoint, id); id < nr_resources && !checkpoint->failed;
+			checkpoint_value(checkpoint, id)) {
+		if (prio_wq[id].waiters) {
+			checkpoint->failed = true;
+			break;
 		}
-		struct process *p = list_first_entry(&r->waitqueue, struct process, list);
+		prio_waitqueue_contend(prio_wq + id);
+		prio_array_serialize(prio_wq[id].waiters, checkpoint);
+	}
+	if (id != UINT_MAX) checkpoint->failed = true;
+}
 
-		assert(p->status == PROCESS_WAIT);
+static int prio_initialize(void)
+{
+	for (unsigned int i = 0; i < nr_cpus; i++) {
+		prio_array_init(prio_rq + i);
+	}
+	prio_waitqueue_init();
+	return 0;
+}
 
-		list_del_init(&p->list);
+static void prio_finalize(void)
+{
+	prio_waitqueue_exit();
+}
+
+static void prio_forked(struct process *p)
+{
+	/* Move the newly forked process from @readyqueue to our own array */
+	list_del_init(&p->list);
+	prio_array_enqueue(prio_rq + p->cpu, p, p->prio_orig);
+}
 
-		p->status = PROCESS_READY;
+static unsigned int prio_nr_ready(void)
+{
+	return prio_rq[this_cpu].nr_active;
+}
 
-		list_add_tail(&p->list, &readyqueue);
+static void prio_serialize(struct checkpoint *checkpoint)
+{
+	for (unsigned int i = 0; i < nr_cpus; i++) {
+		prio_array_serialize(prio_rq + i, checkpoint);
 	}
+	prio_waitqueue_serialize(checkpoint);
 }
 
-struct scheduler prio_scheduler = {
-	.name = "Priority",
-	.acquire = prio_acquire,
-	.release = prio_release,
-	.schedule = prio_schedule,
-};
-
-/***********************************************************************
- * Priority scheduler with priority inheritance protocol
- ***********************************************************************/
-static struct process *pip_schedule(void){
-	struct process *next = NULL;
-	struct process *temp;
-	unsigned int max;
-	unsigned int check = 0;
+static struct process *prio_schedule(void){
+	struct prio_array *rq = prio_rq + this_cpu;
+	struct process *next;
 
 	if (!current || current->status == PROCESS_WAIT || current->age == current->lifespan) {
 		goto pick_next;
 	}
-	if (current->age < current->lifespan && list_empty(&readyqueue)) {
+	if (prio_array_top(rq) < (int)current->prio_orig) {
+		if (slice_expired(current)) slice_start(current);
 		return current;
 	}
-	if (!list_empty(&readyqueue)) {
-		max = current->prio;
-		list_for_each_entry(next, &readyqueue, list){
-			if(max < next->prio) max = next->prio;
-		}
-		list_for_each_entry(next, &readyqueue, list){
-			if(max == next->prio){
-				check=1;
-				break;
-			}
-		}
-		if(check==1){
-			list_add_tail(&current->list, &readyqueue);
-			list_del_init(&next->list);
-
-		}else{
-			return current;
-		}
+	if (prio_array_top(rq) == (int)current->prio_orig && !slice_expired(current)) {
+		return current;
 	}
-	return next;
+	prio_array_enqueue(rq, current, current->prio_orig);
 
 pick_next:
-	if (!list_empty(&readyqueue)) {
-		temp = list_first_entry(&readyqueue, struct process, list);
-		max = temp->prio;
-
-		list_for_each_entry(next, &readyqueue, list){
-			if(max < next->prio) max = next->prio;
-		}
-		list_for_each_entry(next, &readyqueue, list){
-			if(max == next->prio) break;
-		}
-		list_del_init(&next->list);
+	next = prio_array_first(rq);
+	if (next) {
+		prio_array_dequeue(rq, next);
+		slice_start(next);
 	}
 	return next;
 }
 
-bool pip_acquire(int resource_id)
+static bool __prio_acquire(int resource_id, bool shared)
 {
 	struct resource *r = resources + resource_id;
-	if (!r->owner) {
-		r->owner = current;
+	if (resource_take(r, shared)) {
 		return true;
 	}
-	current->status = PROCESS_WAIT;
-
-	if(r->owner->prio < current->prio){
-		r->owner->prio = current->prio;
-	}
-
-	list_add_tail(&current->list, &r->waitqueue);
+	prio_waitqueue_block(resource_id, shared, current->prio_orig);
 	return false;
 }
 
-void pip_release(int resource_id)
+static void __prio_release(int resource_id, bool shared)
 {
 	struct resource *r = resources + resource_id;
 	struct process *p;
-	
-	unsigned int max;
-	assert(r->owner == current);
-	r->owner->prio = r->owner->prio_orig;
-	r->owner = NULL;
-	
-	if (!list_empty(&r->waitqueue)) {
-		p = list_first_entry(&r->waitqueue, struct process, list);
-		max = p->prio;
 
-		list_for_each_entry(p, &r->waitqueue, list){
-			if(p->prio > max) max = p->prio;
-		}
-		list_for_each_entry(p, &r->waitqueue, list){
-			if(p->prio == max)
-				break;
-		}
-		
-		assert(p->status == PROCESS_WAIT);
-		list_del_init(&p->list);
+	resource_put(r, shared);
 
-		struct resource_schedule *rs, *tmp;
-		unsigned int acn=0;
-		unsigned int hon=0;
-		struct process *temp;
-		list_for_each_entry(temp, &p->__resources_to_acquire, list){
-			acn++;
-		}
-		list_for_each_entry(temp, &p->__resources_to_acquire, list){
-			hon++;
-		}
-		if(acn == hon){
-			p->status = PROCESS_READY;
-			list_add_tail(&p->list, &readyqueue);
-			
-		}
+	for (unsigned int nr = 0; (p = prio_waitqueue_wakeup(resource_id, nr)); nr++) {
+		prio_array_enqueue(prio_rq + p->cpu, p, p->prio_orig);
+		if (resource_exclusive(r, p->blocked_shared)) break;
 	}
 }
 
-struct scheduler pip_scheduler = {
+bool prio_acquire(int resource_id)
+{
+	return __prio_acquire(resource_id, false);
+}
+
+bool prio_acquire_shared(int resource_id)
+{
+	return __prio_acquire(resource_id, true);
+}
+
+void prio_release(int resource_id)
+{
+	__prio_release(resource_id, false);
+}
+
+void prio_release_shared(int resource_id)
+{
+	__prio_release(resource_id, true);
+}
+
+struct scheduler prio_scheduler = {
+	.name = "Priority",
+	.tickless = TICKLESS_ALONE,
+	.acquire = prio_acquire,
+	.release = prio_release,
+	.acquire_shared = prio_acquire_shared,
+	.release_shared = prio_release_shared,
+	.initialize = prio_initialize,
+	.finalize = prio_finalize,
+	.forked = prio_forked,
+	.nr_ready = prio_nr_ready,
+	.schedule = prio_schedule,
+	.serialize = prio_serialize,
+};
+
+/***********************************************************************
+ * Priority scheduler with priority inheritance protocol
+ *
+ * A process inherits the highest priority among the waiters of the resources
+ * it is holding. Each process keeps what it is holding in @held, and the
+ * highest waiter priority of a resource is the top of its prio_waitqueue.
+ * Hence, the inherited priority is recalculated only from the resources of
+ * the releasing process rather than from all the resources in the system.
+ *
+ * The inheritance is transitive; when the boosted holder is blocked on another
+ * resource, the boost is propagated to the holders of that resource, and so on.
+ * The propagation stops at the processes that are already important enough,
+ * so it costs no more than the processes on the blocking chains.
+ *
+ * Semaphores and rwlocks held in the shared mode can have many holders at the
+ * same time. A process blocked on such a resource boosts all of its holders
+ * since it cannot tell which of them will release the resource first.
+ ***********************************************************************/
+#include "arena.h"
+
+static __thread struct prio_array pip_rq[MAX_NR_CPUS];
+
+/**
+ * @process holding the resource of @wq
+ */
+struct pip_hold {
+	struct process *process;
+	struct prio_waitqueue *wq;
+	struct list_head list;		/* Entry in @held of @process */
+	struct list_head holders;	/* Entry in @holders of @wq */
+};
+
+static __thread struct arena pip_hold_arena;
+static __thread struct list_head pip_free_holds;
+
+static int pip_initialize(void)
+{
+	for (unsigned int i = 0; i < nr_cpus; i++) {
+		prio_array_init(pip_rq + i);
+	}
+	prio_waitqueue_init();
+
+	arena_init(&pip_hold_arena);
+	INIT_LIST_HEAD(&pip_free_holds);
+	return 0;
+}
+
+static void pip_finalize(void)
+{
+	prio_waitqueue_exit();
+	arena_destroy(&pip_hold_arena);
+}
+
+static void pip_forked(struct process *p)
+{
+	INIT_LIST_HEAD(&p->held);
+
+	list_del_init(&p->list);
+	prio_array_enqueue(pip_rq + p->cpu, p, p->prio);
+}
+
+static unsigned int pip_nr_ready(void)
+{
+	return pip_rq[this_cpu].nr_active;
+}
+
+static struct process *pip_schedule(void){
+	struct prio_array *rq = pip_rq + this_cpu;
+	struct process *next;
+
+	if (!current || current->status == PROCESS_WAIT || current->age == current->lifespan) {
+		goto pick_next;
+	}
+	if (prio_array_top(rq) < (int)current->prio) {
+		if (slice_expired(current)) slice_start(current);
+		return current;
+	}
+	if (prio_array_top(rq) == (int)current->prio && !slice_expired(current)) {
+		return current;
+	}
+	prio_array_enqueue(rq, current, current->prio);
+
+pick_next:
+	next = prio_array_first(rq);
+	if (next) {
+		prio_array_dequeue(rq, next);
+		slice_start(next);
+	}
+	return next;
+}
+
+/**
+ * Record that @p holds the resource of @wq
+ */
+static void pip_hold(struct process *p, struct prio_waitqueue *wq)
+{
+	struct pip_hold *h;
+
+	if (list_empty(&pip_free_holds)) {
+		h = arena_alloc(&pip_hold_arena, sizeof(*h));
+	} else {
+		h = list_first_entry(&pip_free_holds, struct pip_hold, list);
+		list_del(&h->list);
+	}
+	h->process = p;
+	h->wq = wq;
+	list_add(&h->list, &p->held);
+	list_add_tail(&h->holders, &wq->holders);
+}
+
+/**
+ * Drop the record that @current holds the resource of @wq
+ */
+static void pip_unhold(struct prio_waitqueue *wq)
+{
+	struct pip_hold *h;
+
+	list_for_each_entry(h, &current->held, list) {
+		if (h->wq == wq) break;
+	}
+	assert(&h->list != &current->held);
+	list_del(&h->holders);
+	list_move(&h->list, &pip_free_holds);
+}
+
+/**
+ * Wake up the waiters of @resource_id into the ready queues as many as they
+ * can take the resource
+ */
+static void pip_wakeup(int resource_id)
+{
+	struct resource *r = resources + resource_id;
+	struct process *p;
+
+	for (unsigned int nr = 0; (p = prio_waitqueue_wakeup(resource_id, nr)); nr++) {
+		prio_array_enqueue(pip_rq + p->cpu, p, p->prio);
+		if (resource_exclusive(r, p->blocked_shared)) break;
+	}
+}
+
+static void pip_boost(struct process *p, unsigned int prio);
+
+/**
+ * Boost the holders of @wq to @prio
+ */
+static void pip_boost_holders(struct prio_waitqueue *wq, unsigned int prio)
+{
+	struct pip_hold *h;
+
+	list_for_each_entry(h, &wq->holders, holders) {
+		pip_boost(h->process, prio);
+	}
+}
+
+/**
+ * Boost @p to @prio, and propagate the boost along the blocking chain
+ */
+static void pip_boost(struct process *p, unsigned int prio)
+{
+	if (p->prio >= prio) return;
+
+	p->prio = prio;
+
+	/* Reflect the boost to the queue @p is waiting in */
+	if (p->status == PROCESS_READY) {
+		prio_array_requeue(pip_rq + p->cpu, p, prio);
+	} else if (p->status == PROCESS_WAIT) {
+		struct prio_waitqueue *wq = prio_wq + (p->blocked_on - resources);
+
+		prio_array_requeue(wq->waiters, p, prio);
+		pip_boost_holders(wq, prio);
+	}
+}
+
+static bool __pip_acquire(int resource_id, bool shared)
+{
+	struct resource *r = resources + resource_id;
+	struct prio_waitqueue *wq = prio_wq + resource_id;
+
+	if (resource_take(r, shared)) {
+		int top = prio_waitqueue_top(wq);
+
+		pip_hold(current, wq);
+
+		/* Processes might be left waiting since the previous holder */
+		if (top > (int)current->prio) current->prio = top;
+		return true;
+	}
+
+	prio_waitqueue_block(resource_id, shared, current->prio);
+	pip_boost_holders(wq, current->prio);
+	return false;
+}
+
+static void __pip_release(int resource_id, bool shared)
+{
+	struct resource *r = resources + resource_id;
+	struct prio_waitqueue *wq = prio_wq + resource_id;
+	struct pip_hold *h;
+	unsigned int prio = current->prio_orig;
+
+	resource_put(r, shared);
+	pip_unhold(wq);
+	pip_wakeup(resource_id);
+
+	/* Inherit from the waiters of the resources still being held */
+	list_for_each_entry(h, &current->held, list) {
+		int top = prio_waitqueue_top(h->wq);
+
+		if (top > (int)prio) prio = top;
+	}
+	current->prio = prio;
+}
+
+/**
+ * Save or restore the ready queues, the waiters, and the holders of the
+ * resources. The holders are restored in @held in the order of the resources,
+ * which does not matter as the inherited priority is the highest among them
+ */
+static void pip_serialize(struct checkpoint *checkpoint)
+{
+	unsigned int id;
+
+	for (unsigned int i = 0; i < nr_cpus; i++) {
+		prio_array_serialize(pip_rq + i, checkpoint);
+	}
+	prio_waitqueue_serialize(checkpoint);
+
+	if (!checkpoint->restoring) {
+		for (id = 0; id < nr_resources; id++) {
+			struct pip_hold *h;
+			unsigned int nr = 0;
+
+			if (list_empty(&prio_wq[id].holders)) continue;
+
+			list_for_each_entry(h, &prio_wq[id].holders, holders) nr++;
+			checkpoint_value(checkpoint, id);
+			checkpoint_value(checkpoint, nr);
+			list_for_each_entry(h, &prio_wq[id].holders, holders) {
+				checkpoint_process(checkpoint, &h->process);
+			}
+		}
+		id = UINT_MAX;
+		checkpoint_value(checkpoint, id);
+		return;
+	}
+
+	for (unsigned long i = 0; i < checkpoint->nr_processes; i++) {
+		INIT_LIST_HEAD(&checkpoint->processes[i]->held);
+	}
+	for (checkpoint_value(checkpoint, id); id < nr_resources && !checkpoint->failed;
+			checkpoint_value(checkpoint, id)) {
+		unsigned int nr;
+
+		checkpoint_value(checkpoint, nr);
+		for (unsigned int i = 0; i < nr && !checkpoint->failed; i++) {
+			struct process *p;
+
+			checkpoint_process(checkpoint, &p);
+			if (p) pip_hold(p, prio_wq + id);
+			else checkpoint->failed = true;
+		}
+	}
+	if (id != UINT_MAX) checkpoint->failed = true;
+}
+
+bool pip_acquire(int resource_id)
+{
+	return __pip_acquire(resource_id, false);
+}
+
+bool pip_acquire_shared(int resource_id)
+{
+	return __pip_acquire(resource_id, true);
+}
+
+void pip_release(int resource_id)
+{
+	__pip_release(resource_id, false);
+}
+
+void pip_release_shared(int resource_id)
+{
+	__pip_release(resource_id, true);
+}
+
+struct scheduler pip_scheduler = {
 	.name = "Priority + Priority Inheritance Protocol",
+	.tickless = TICKLESS_ALONE,
 	.acquire = pip_acquire,
 	.release = pip_release,
+	.acquire_shared = pip_acquire_shared,
+	.release_shared = pip_release_shared,
+	.initialize = pip_initialize,
+	.finalize = pip_finalize,
+	.forked = pip_forked,
+	.nr_ready = pip_nr_ready,
 	.schedule = pip_schedule,
+	.serialize = pip_serialize,
 	/* It goes without saying to implement your own pip_schedule() */
 };
+
+
+/***********************************************************************
+ * Priority scheduler with the immediate priority ceiling protocol
+ *
+ * A process holding a resource runs at the ceiling of the resource, which is
+ * the highest priority of the processes that would ever acquire it. Hence
+ * no one that might want the resource can preempt the holder, and a process
+ * is blocked at most for one critical section of lower-priority processes.
+ * Unlike PIP, acquiring and releasing resources never walk the blocking chains
+ * or the waiters to adjust priorities. It shares the ready queues and the
+ * hold records with the PIP scheduler.
+ ***********************************************************************/
+static bool __ceiling_acquire(int resource_id, bool shared)
+{
+	struct resource *r = resources + resource_id;
+
+	if (resource_take(r, shared)) {
+		pip_hold(current, prio_wq + resource_id);
+		if (r->ceiling > current->prio) current->prio = r->ceiling;
+		return true;
+	}
+
+	/**
+	 * Still can be blocked by holders of the same priority or on other CPUs,
+	 * or at semaphores and rwlocks
+	 */
+	prio_waitqueue_block(resource_id, shared, current->prio);
+	return false;
+}
+
+static void __ceiling_release(int resource_id, bool shared)
+{
+	struct pip_hold *h;
+	unsigned int prio = current->prio_orig;
+
+	resource_put(resources + resource_id, shared);
+	pip_unhold(prio_wq + resource_id);
+	pip_wakeup(resource_id);
+
+	/* Run at the highest ceiling of the resources still being held */
+	list_for_each_entry(h, &current->held, list) {
+		struct resource *r = resources + (h->wq - prio_wq);
+
+		if (r->ceiling > prio) prio = r->ceiling;
+	}
+	current->prio = prio;
+}
+
+bool ceiling_acquire(int resource_id)
+{
+	return __ceiling_acquire(resource_id, false);
+}
+
+bool ceiling_acquire_shared(int resource_id)
+{
+	return __ceiling_acquire(resource_id, true);
+}
+
+void ceiling_release(int resource_id)
+{
+	__ceiling_release(resource_id, false);
+}
+
+void ceiling_release_shared(int resource_id)
+{
+	__ceiling_release(resource_id, true);
+}
+
+struct scheduler ceiling_scheduler = {
+	.name = "Priority + Priority Ceiling Protocol",
+	.tickless = TICKLESS_ALONE,
+	.acquire = ceiling_acquire,
+	.release = ceiling_release,
+	.acquire_shared = ceiling_acquire_shared,
+	.release_shared = ceiling_release_shared,
+	.initialize = pip_initialize,
+	.finalize = pip_finalize,
+	.forked = pip_forked,
+	.nr_ready = pip_nr_ready,
+	.schedule = pip_schedule,
+	.serialize = pip_serialize,
+};
+
+
+/***********************************************************************
+ * Multi-level feedback queue scheduler
+ *
+ * Processes start at the top level, and are demoted by one level whenever
+ * they use up the time slice of their level. The slice doubles as the level
+ * goes down from @quantum ticks at the top. A process at a higher level
+ * preempts those at lower levels, and the processes at the same level are
+ * scheduled in the round-robin way. Every MLFQ_BOOST_PERIOD slices of the
+ * top level, all the processes are boosted to the top level again so that
+ * demoted ones do not starve.
+ *
+ * The level of a process is kept in @prio, and the ready processes are kept in
+ * a prio_array indexed by the level. The priorities given in the script are
+ * not used. Resources are served in the FCFS way, and the woken up processes
+ * are brought from @readyqueue with the levels they had when blocked.
+ *
+ * The demotion and the boost depend on every tick, so schedule() is called on
+ * every tick even when the current process would run alone.
+ ***********************************************************************/
+#define MLFQ_NR_LEVELS		4
+#define MLFQ_BOOST_PERIOD	64
+
+static __thread struct prio_array mlfq_rq[MAX_NR_CPUS];
+static __thread unsigned int mlfq_boosted_at[MAX_NR_CPUS];
+
+/**
+ * The slices and the boost period are computed in 64 bits not to overflow
+ * with a large -Q
+ */
+static inline unsigned long long mlfq_quantum(unsigned int level)
+{
+	return (unsigned long long)quantum << (MLFQ_NR_LEVELS - 1 - level);
+}
+
+/**
+ * When the latest boost was due
+ */
+static inline unsigned int mlfq_boost_at(void)
+{
+	unsigned long long period = (unsigned long long)quantum * MLFQ_BOOST_PERIOD;
+
+	return ticks - ticks % period;
+}
+
+static void mlfq_boost(struct process *p)
+{
+	p->prio = MLFQ_NR_LEVELS - 1;
+	p->boosted_at = ticks;
+}
+
+static int mlfq_initialize(void)
+{
+	for (unsigned int i = 0; i < nr_cpus; i++) {
+		prio_array_init(mlfq_rq + i);
+		mlfq_boosted_at[i] = 0;
+	}
+	return 0;
+}
+
+static void mlfq_forked(struct process *p)
+{
+	mlfq_boost(p);
+}
+
+static unsigned int mlfq_nr_ready(void)
+{
+	return mlfq_rq[this_cpu].nr_active;
+}
+
+/**
+ * Boost the processes on this CPU if a boost is due. Processes that were
+ * blocked through the boost are boosted when they are woken up
+ */
+static void mlfq_boost_all(void)
+{
+	struct prio_array *rq = mlfq_rq + this_cpu;
+	unsigned int boost_at = mlfq_boost_at();
+	struct process *p, *tmp;
+
+	if (mlfq_boosted_at[this_cpu] >= boost_at) return;
+	mlfq_boosted_at[this_cpu] = boost_at;
+
+	/* Move the lower levels to the top in their order */
+	for (int level = MLFQ_NR_LEVELS - 2; level >= 0; level--) {
+		list_for_each_entry_safe(p, tmp, rq->queue + level, list) {
+			prio_array_dequeue(rq, p);
+			mlfq_boost(p);
+			prio_array_enqueue(rq, p, p->prio);
+		}
+	}
+	if (current) mlfq_boost(current);
+}
+
+static struct process *mlfq_schedule(void)
+{
+	struct prio_array *rq = mlfq_rq + this_cpu;
+	struct process *p, *tmp, *next;
+	bool expired;
+
+	mlfq_boost_all();
+
+	list_for_each_entry_safe(p, tmp, &readyqueue, list) {
+		list_del_init(&p->list);
+		if (p->boosted_at < mlfq_boost_at()) mlfq_boost(p);
+		prio_array_enqueue(rq, p, p->prio);
+	}
+
+	if (!current || current->status == PROCESS_WAIT || current->age == current->lifespan) {
+		goto pick_next;
+	}
+
+	expired = current->age - current->slice_at >= mlfq_quantum(current->prio);
+	if (expired && current->prio) {
+		current->prio--;
+	}
+	if (prio_array_top(rq) < (int)current->prio ||
+			(prio_array_top(rq) == (int)current->prio && !expired)) {
+		if (expired) slice_start(current);
+		return current;
+	}
+	prio_array_enqueue(rq, current, current->prio);
+
+pick_next:
+	next = prio_array_first(rq);
+	if (next) {
+		prio_array_dequeue(rq, next);
+		slice_start(next);
+	}
+	return next;
+}
+
+static void mlfq_serialize(struct checkpoint *checkpoint)
+{
+	for (unsigned int i = 0; i < nr_cpus; i++) {
+		prio_array_serialize(mlfq_rq + i, checkpoint);
+		checkpoint_value(checkpoint, mlfq_boosted_at[i]);
+	}
+}
+
+struct scheduler mlfq_scheduler = {
+	.name = "Multi-level Feedback Queue",
+	.acquire = fcfs_acquire,
+	.release = fcfs_release,
+	.acquire_shared = fcfs_acquire_shared,
+	.release_shared = fcfs_release_shared,
+	.initialize = mlfq_initialize,
+	.forked = mlfq_forked,
+	.nr_ready = mlfq_nr_ready,
+	.schedule = mlfq_schedule,
+	.serialize = mlfq_serialize,
+};
+
+
+/***********************************************************************
+ * Proportional-share schedulers
+ *
+ * A process holds @prio + 1 tickets, and gets the CPU in proportion to its
+ * tickets among the runnable processes of its CPU. Resources are served in
+ * the FCFS way, and time slices are given as the round-robin does (-Q).
+ ***********************************************************************/
+static unsigned int share_tickets(struct process *p)
+{
+	return p->prio + 1;
+}
+
+
+/***********************************************************************
+ * Stride scheduler
+ *
+ * A process advances its pass by its stride, which is inversely proportional
+ * to its tickets, on each tick it runs, and the process with the smallest
+ * pass runs next. The pass is kept as the one at age 0 so that it advances
+ * with @age without being updated on every tick. Ready processes are kept in
+ * a min-heap keyed by the pass. A process that comes back from blocking or
+ * is forked starts from the pass of the current process, so it can neither
+ * claim the share for the time it was not runnable nor be left behind.
+ ***********************************************************************/
+#define STRIDE_ONE	(1U << 20)
+
+static __thread struct heap stride_rq[MAX_NR_CPUS];
+static __thread unsigned long long stride_global_pass[MAX_NR_CPUS];
+
+static inline unsigned long long stride_pass(struct process *p)
+{
+	return p->pass + (unsigned long long)p->age * (STRIDE_ONE / share_tickets(p));
+}
+
+static int stride_initialize(void)
+{
+	for (unsigned int i = 0; i < nr_cpus; i++) {
+		heap_init(stride_rq + i);
+		stride_global_pass[i] = 0;
+	}
+	return 0;
+}
+
+static void stride_finalize(void)
+{
+	for (unsigned int i = 0; i < nr_cpus; i++) {
+		heap_free(stride_rq + i);
+	}
+}
+
+static unsigned int stride_nr_ready(void)
+{
+	return stride_rq[this_cpu].nr;
+}
+
+static struct process *stride_schedule(void)
+{
+	struct heap *rq = stride_rq + this_cpu;
+	unsigned long long *global_pass = stride_global_pass + this_cpu;
+	struct process *p, *tmp, *next;
+
+	if (current && current->status != PROCESS_WAIT) {
+		*global_pass = stride_pass(current);
+	}
+
+	list_for_each_entry_safe(p, tmp, &readyqueue, list) {
+		unsigned long long pass = stride_pass(p);
+
+		if (pass < *global_pass) {
+			p->pass += *global_pass - pass;
+			pass = *global_pass;
+		}
+		list_del_init(&p->list);
+		heap_push(rq, p, pass);
+	}
+
+	if (!current || current->status == PROCESS_WAIT || current->age == current->lifespan) {
+		goto pick_next;
+	}
+	if (!slice_expired(current)) {
+		return current;
+	}
+	if (heap_empty(rq)) {
+		slice_start(current);
+		return current;
+	}
+	heap_push(rq, current, stride_pass(current));
+
+pick_next:
+	next = heap_pop(rq);
+	if (next) {
+		slice_start(next);
+	}
+	return next;
+}
+
+static void stride_serialize(struct checkpoint *checkpoint)
+{
+	for (unsigned int i = 0; i < nr_cpus; i++) {
+		heap_serialize(stride_rq + i, checkpoint);
+		checkpoint_value(checkpoint, stride_global_pass[i]);
+	}
+}
+
+struct scheduler stride_scheduler = {
+	.name = "Stride",
+	.tickless = TICKLESS_ALONE,
+	.acquire = fcfs_acquire,
+	.release = fcfs_release,
+	.acquire_shared = fcfs_acquire_shared,
+	.release_shared = fcfs_release_shared,
+	.initialize = stride_initialize,
+	.finalize = stride_finalize,
+	.nr_ready = stride_nr_ready,
+	.schedule = stride_schedule,
+	.tickets = share_tickets,
+	.serialize = stride_serialize,
+};
+
+
+/***********************************************************************
+ * Lottery scheduler
+ *
+ * The next process is drawn at random with the probability proportional to
+ * its tickets. Ready processes are kept densely in @slots, and a Fenwick tree
+ * over their tickets finds the winner of a draw in O(log N). A slot taken out
+ * is filled with the last one to keep the slots dense. The draws come from a
+ * fixed seed so that a simulation is reproducible, and no draw is made while
+ * the current process runs alone.
+ ***********************************************************************/
+static __thread struct lottery_rq {
+	struct process **slots;		/* Ready processes in slots 1 to @nr */
+	unsigned int *tickets;		/* Tickets of @slots */
+	unsigned long *tree;		/* Fenwick tree over @tickets */
+	unsigned int nr;
+	unsigned int size;			/* # of slots. Power of 2 */
+	unsigned long total;		/* Sum of @tickets */
+} lottery_rq[MAX_NR_CPUS];
+
+static __thread unsigned long long lottery_seed;
+
+#define LOTTERY_SEED	0x2019ULL
+
+/**
+ * xorshift64* pseudo random number generator
+ */
+static unsigned long long lottery_random(void)
+{
+	lottery_seed ^= lottery_seed >> 12;
+	lottery_seed ^= lottery_seed << 25;
+	lottery_seed ^= lottery_seed >> 27;
+	return lottery_seed * 0x2545f4914f6cdd1dULL;
+}
+
+static void lottery_update(struct lottery_rq *rq, unsigned int slot, long delta)
+{
+	for (; slot <= rq->size; slot += slot & -slot) {
+		rq->tree[slot] += delta;
+	}
+}
+
+/**
+ * Build the tree from @tickets in O(N)
+ */
+static void lottery_build(struct lottery_rq *rq)
+{
+	for (unsigned int i = 1; i <= rq->size; i++) {
+		rq->tree[i] = i <= rq->nr ? rq->tickets[i] : 0;
+	}
+	for (unsigned int i = 1; i <= rq->size; i++) {
+		unsigned int parent = i + (i & -i);
+
+		if (parent <= rq->size) rq->tree[parent] += rq->tree[i];
+	}
+}
+
+static void lottery_grow(struct lottery_rq *rq)
+{
+	rq->size = rq->size ? rq->size * 2 : 64;
+	rq->slots = realloc(rq->slots, sizeof(*rq->slots) * (rq->size + 1));
+	rq->tickets = realloc(rq->tickets, sizeof(*rq->tickets) * (rq->size + 1));
+	rq->tree = realloc(rq->tree, sizeof(*rq->tree) * (rq->size + 1));
+	assert(rq->slots && rq->tickets && rq->tree);
+
+	lottery_build(rq);
+}
+
+static void lottery_enqueue(struct lottery_rq *rq, struct process *p)
+{
+	unsigned int slot;
+
+	if (rq->nr == rq->size) lottery_grow(rq);
+
+	slot = ++rq->nr;
+	rq->slots[slot] = p;
+	rq->tickets[slot] = share_tickets(p);
+	rq->total += rq->tickets[slot];
+	lottery_update(rq, slot, rq->tickets[slot]);
+}
+
+/**
+ * Draw the winner among the ready processes and take it out of @rq
+ */
+static struct process *lottery_draw(struct lottery_rq *rq)
+{
+	unsigned long winner;
+	unsigned int slot = 0;
+	struct process *p;
+
+	if (!rq->nr) return NULL;
+
+	/* Find the slot whose tickets cover the winning ticket */
+	winner = lottery_random() % rq->total;
+	for (unsigned int step = rq->size; step; step >>= 1) {
+		if (slot + step <= rq->size && rq->tree[slot + step] <= winner) {
+			slot += step;
+			winner -= rq->tree[slot];
+		}
+	}
+	slot++;
+	p = rq->slots[slot];
+
+	rq->total -= rq->tickets[slot];
+	lottery_update(rq, slot, -(long)rq->tickets[slot]);
+	if (slot != rq->nr) {
+		unsigned int last = rq->nr;
+
+		lottery_update(rq, last, -(long)rq->tickets[last]);
+		lottery_update(rq, slot, rq->tickets[last]);
+		rq->slots[slot] = rq->slots[last];
+		rq->tickets[slot] = rq->tickets[last];
+	}
+	rq->nr--;
+
+	return p;
+}
+
+static int lottery_initialize(void)
+{
+	for (unsigned int i = 0; i < nr_cpus; i++) {
+		struct lottery_rq *rq = lottery_rq + i;
+
+		rq->slots = NULL;
+		rq->tickets = NULL;
+		rq->tree = NULL;
+		rq->nr = rq->size = 0;
+		rq->total = 0;
+		lottery_grow(rq);
+	}
+	lottery_seed = LOTTERY_SEED;
+	return 0;
+}
+
+static void lottery_finalize(void)
+{
+	for (unsigned int i = 0; i < nr_cpus; i++) {
+		free(lottery_rq[i].slots);
+		free(lottery_rq[i].tickets);
+		free(lottery_rq[i].tree);
+	}
+}
+
+static unsigned int lottery_nr_ready(void)
+{
+	return lottery_rq[this_cpu].nr;
+}
+
+static struct process *lottery_schedule(void)
+{
+	struct lottery_rq *rq = lottery_rq + this_cpu;
+	struct process *p, *tmp, *next;
+
+	list_for_each_entry_safe(p, tmp, &readyqueue, list) {
+		list_del_init(&p->list);
+		lottery_enqueue(rq, p);
+	}
+
+	if (!current || current->status == PROCESS_WAIT || current->age == current->lifespan) {
+		goto pick_next;
+	}
+	if (!slice_expired(current)) {
+		return current;
+	}
+	if (!rq->nr) {
+		slice_start(current);
+		return current;
+	}
+	lottery_enqueue(rq, current);
+
+pick_next:
+	next = lottery_draw(rq);
+	if (next) {
+		slice_start(next);
+	}
+	return next;
+}
+
+static void lottery_serialize(struct checkpoint *checkpoint)
+{
+	checkpoint_value(checkpoint, lottery_seed);
+
+	for (unsigned int i = 0; i < nr_cpus; i++) {
+		struct lottery_rq *rq = lottery_rq + i;
+		unsigned int nr = rq->nr, size = rq->size;
+
+		checkpoint_value(checkpoint, nr);
+		checkpoint_value(checkpoint, size);
+		if (checkpoint->restoring) {
+			while (!checkpoint->failed && rq->size < size) lottery_grow(rq);
+			if (checkpoint->failed || rq->size != size || nr > size) {
+				checkpoint->failed = true;
+				return;
+			}
+		}
+
+		for (unsigned int slot = 1; slot <= nr; slot++) {
+			checkpoint_process(checkpoint, rq->slots + slot);
+			checkpoint_value(checkpoint, rq->tickets[slot]);
+		}
+
+		if (checkpoint->restoring) {
+			rq->nr = nr;
+			for (unsigned int slot = 1; slot <= nr; slot++) {
+				rq->total += rq->tickets[slot];
+			}
+			lottery_build(rq);
+		}
+	}
+}
+
+struct scheduler lottery_scheduler = {
+	.name = "Lottery",
+	.tickless = TICKLESS_ALONE,
+	.acquire = fcfs_acquire,
+	.release = fcfs_release,
+	.acquire_shared = fcfs_acquire_shared,
+	.release_shared = fcfs_release_shared,
+	.initialize = lottery_initialize,
+	.finalize = lottery_finalize,
+	.nr_ready = lottery_nr_ready,
+	.schedule = lottery_schedule,
+	.tickets = share_tickets,
+	.serialize = lottery_serialize,
+};
+
+
+/***********************************************************************
+ * Completely fair scheduler
+ *
+ * Borrowed from CFS of Linux. Each process accumulates the virtual runtime,
+ * its runtime scaled by the inverse of its weight, and the process with the
+ * smallest virtual runtime runs next. Ready processes are kept in a red-black
+ * tree sorted by the virtual runtime with the leftmost one cached, so that the
+ * next one is found in O(1) and a process is queued in O(log N).
+ *
+ * @prio is mapped onto the nice values of Linux; priority 39 and above get
+ * the weight of nice -20, and priority 0 gets that of nice 19. The current
+ * process runs for its share of the scheduling period, which is
+ * @sched_latency or @min_granularity times the runnable processes if there
+ * are too many of them. @min_granularity is the time quantum (-Q), and
+ * @sched_latency is CFS_NR_LATENCY times that as in Linux.
+ *
+ * Forked processes start at @min_vruntime, the smallest virtual runtime
+ * of the CPU which never goes back. Processes woken up are placed no earlier
+ * than half @sched_latency behind @min_vruntime so that they cannot hold the
+ * CPU for the time they were sleeping. As the pass of the stride scheduler,
+ * the virtual runtime is kept as the one at age 0.
+ ***********************************************************************/
+#define CFS_NICE_0_LOAD		1024
+#define CFS_NR_LATENCY		8
+#define CFS_VRUNTIME_SCALE	(1ULL << 20)	/* Virtual runtime of a tick at nice 0 */
+
+static const unsigned int cfs_prio_to_weight[40] = {
+	/* -20 */ 88761, 71755, 56483, 46273, 36291,
+	/* -15 */ 29154, 23254, 18705, 14949, 11916,
+	/* -10 */  9548,  7620,  6100,  4904,  3906,
+	/*  -5 */  3121,  2501,  1991,  1586,  1277,
+	/*   0 */  1024,   820,   655,   526,   423,
+	/*   5 */   335,   272,   215,   172,   137,
+	/*  10 */   110,    87,    70,    56,    45,
+	/*  15 */    36,    29,    23,    18,    15,
+};
+
+static __thread struct cfs_rq {
+	struct rb_root_cached tasks;	/* Ready processes */
+	unsigned int nr;
+	unsigned long load;				/* Sum of the weights of @tasks */
+	unsigned long long min_vruntime;
+} cfs_rq[MAX_NR_CPUS];
+
+static unsigned int cfs_weight(struct process *p)
+{
+	return cfs_prio_to_weight[39 - (p->prio < 39 ? p->prio : 39)];
+}
+
+/**
+ * Virtual runtime @p accumulates on each tick it runs
+ */
+static inline unsigned long long cfs_delta(struct process *p)
+{
+	return CFS_VRUNTIME_SCALE * CFS_NICE_0_LOAD / cfs_weight(p);
+}
+
+static inline unsigned long long cfs_vruntime(struct process *p)
+{
+	return p->vruntime + p->age * cfs_delta(p);
+}
+
+static inline struct process *cfs_first(struct cfs_rq *rq)
+{
+	struct rb_node *leftmost = rb_first_cached(&rq->tasks);
+
+	return leftmost ? rb_entry(leftmost, struct process, rq_node) : NULL;
+}
+
+static void cfs_enqueue(struct cfs_rq *rq, struct process *p)
+{
+	struct rb_node **link = &rq->tasks.rb_root.rb_node, *parent = NULL;
+	unsigned long long vruntime = cfs_vruntime(p);
+	bool leftmost = true;
+
+	/* Processes with the same virtual runtime are served in the FIFO order */
+	while (*link) {
+		parent = *link;
+		if (vruntime < cfs_vruntime(rb_entry(parent, struct process, rq_node))) {
+			link = &parent->rb_left;
+		} else {
+			link = &parent->rb_right;
+			leftmost = false;
+		}
+	}
+	rb_link_node(&p->rq_node, parent, link);
+	rb_insert_color_cached(&p->rq_node, &rq->tasks, leftmost);
+
+	rq->nr++;
+	rq->load += cfs_weight(p);
+}
+
+static void cfs_dequeue(struct cfs_rq *rq, struct process *p)
+{
+	rb_erase_cached(&p->rq_node, &rq->tasks);
+
+	rq->nr--;
+	rq->load -= cfs_weight(p);
+}
+
+static void cfs_update_min_vruntime(struct cfs_rq *rq)
+{
+	struct process *first = cfs_first(rq);
+	unsigned long long vruntime = rq->min_vruntime;
+	bool running = current && current->status == PROCESS_RUNNING;
+
+	if (running) vruntime = cfs_vruntime(current);
+	if (first && (!running || cfs_vruntime(first) < vruntime)) {
+		vruntime = cfs_vruntime(first);
+	}
+	if (vruntime > rq->min_vruntime) rq->min_vruntime = vruntime;
+}
+
+/**
+ * Move @p to @vruntime in the virtual time
+ */
+static inline void cfs_place(struct process *p, unsigned long long vruntime)
+{
+	p->vruntime += vruntime - cfs_vruntime(p);
+}
+
+/**
+ * The ticks @current may run for until the others get their turns
+ */
+static unsigned int cfs_slice(struct cfs_rq *rq)
+{
+	unsigned int nr_running = rq->nr + 1;
+	unsigned long long period = (unsigned long long)quantum * CFS_NR_LATENCY;
+	unsigned long long slice;
+
+	if (nr_running > CFS_NR_LATENCY) period = (unsigned long long)quantum * nr_running;
+
+	slice = period * cfs_weight(current) / (rq->load + cfs_weight(current));
+	return slice ? slice : 1;
+}
+
+/**
+ * Whether @current should give the CPU to the first ready process
+ */
+static bool cfs_preempt(struct cfs_rq *rq)
+{
+	unsigned int slice = cfs_slice(rq);
+	unsigned int ran = current->age - current->slice_at;
+	unsigned long long vruntime = cfs_vruntime(current);
+	unsigned long long first = cfs_vruntime(cfs_first(rq));
+
+	if (ran >= slice) return true;
+	if (ran < quantum) return false;
+
+	/* Ahead of the first by more than the slice in the virtual time */
+	return vruntime > first && vruntime - first > slice * cfs_delta(current);
+}
+
+static int cfs_initialize(void)
+{
+	for (unsigned int i = 0; i < nr_cpus; i++) {
+		cfs_rq[i].tasks = RB_ROOT_CACHED;
+		cfs_rq[i].nr = 0;
+		cfs_rq[i].load = 0;
+		cfs_rq[i].min_vruntime = 0;
+	}
+	return 0;
+}
+
+static void cfs_forked(struct process *p)
+{
+	struct cfs_rq *rq = cfs_rq + p->cpu;
+
+	cfs_update_min_vruntime(rq);
+	p->vruntime = rq->min_vruntime;
+}
+
+static unsigned int cfs_nr_ready(void)
+{
+	return cfs_rq[this_cpu].nr;
+}
+
+static struct process *cfs_schedule(void)
+{
+	struct cfs_rq *rq = cfs_rq + this_cpu;
+	struct process *p, *tmp, *next;
+	unsigned long long thresh = (unsigned long long)quantum * CFS_NR_LATENCY *
+			CFS_VRUNTIME_SCALE / 2;
+
+	cfs_update_min_vruntime(rq);
+
+	list_for_each_entry_safe(p, tmp, &readyqueue, list) {
+		list_del_init(&p->list);
+		if (rq->min_vruntime > thresh && cfs_vruntime(p) < rq->min_vruntime - thresh) {
+			cfs_place(p, rq->min_vruntime - thresh);
+		}
+		cfs_enqueue(rq, p);
+	}
+
+	if (!current || current->status == PROCESS_WAIT || current->age == current->lifespan) {
+		goto pick_next;
+	}
+	if (!rq->nr || !cfs_preempt(rq)) {
+		return current;
+	}
+	cfs_enqueue(rq, current);
+
+pick_next:
+	next = cfs_first(rq);
+	if (next) {
+		cfs_dequeue(rq, next);
+		slice_start(next);
+	}
+	return next;
+}
+
+/**
+ * Processes are queued after those with the same virtual runtime, so queueing
+ * them again in the order restores the same order
+ */
+static void cfs_serialize(struct checkpoint *checkpoint)
+{
+	for (unsigned int i = 0; i < nr_cpus; i++) {
+		struct cfs_rq *rq = cfs_rq + i;
+		unsigned int nr = rq->nr;
+
+		checkpoint_value(checkpoint, rq->min_vruntime);
+		checkpoint_value(checkpoint, nr);
+
+		if (!checkpoint->restoring) {
+			for (struct rb_node *node = rb_first_cached(&rq->tasks); node;
+					node = rb_next(node)) {
+				struct process *p = rb_entry(node, struct process, rq_node);
+
+				checkpoint_process(checkpoint, &p);
+			}
+			continue;
+		}
+
+		for (unsigned int j = 0; j < nr && !checkpoint->failed; j++) {
+			struct process *p;
+
+			checkpoint_process(checkpoint, &p);
+			if (p) cfs_enqueue(rq, p);
+			else checkpoint->failed = true;
+		}
+	}
+}
+
+struct scheduler cfs_scheduler = {
+	.name = "Completely Fair",
+	.tickless = TICKLESS_ALONE,
+	.acquire = fcfs_acquire,
+	.release = fcfs_release,
+	.acquire_shared = fcfs_acquire_shared,
+	.release_shared = fcfs_release_shared,
+	.initialize = cfs_initialize,
+	.forked = cfs_forked,
+	.nr_ready = cfs_nr_ready,
+	.schedule = cfs_schedule,
+	.tickets = cfs_weight,
+	.serialize = cfs_serialize,
+};
+
+
+/***********************************************************************
+ * Work-stealing scheduler
+ *
+ * Each CPU schedules its own processes in the round-robin way. A CPU that
+ * runs out of processes steals the half of the ready processes from the CPU
+ * with the longest ready queue. Stolen processes are ready on the new CPU
+ * after @migration_cost ticks.
+ ***********************************************************************/
+static __thread struct ws_rq {
+	struct list_head queue;		/* Processes ready to run on this CPU */
+	unsigned int nr;
+
+	struct list_head incoming;	/* Processes being migrated to this CPU */
+	unsigned int nr_incoming;
+	unsigned int incoming_at;	/* When @incoming get ready on this CPU */
+} ws_rq[MAX_NR_CPUS];
+
+static int ws_initialize(void)
+{
+	for (unsigned int i = 0; i < nr_cpus; i++) {
+		struct ws_rq *rq = ws_rq + i;
+
+		INIT_LIST_HEAD(&rq->queue);
+		INIT_LIST_HEAD(&rq->incoming);
+		rq->nr = rq->nr_incoming = 0;
+	}
+	return 0;
+}
+
+static unsigned int ws_nr_ready(void)
+{
+	return ws_rq[this_cpu].nr + ws_rq[this_cpu].nr_incoming;
+}
+
+/**
+ * Collect the processes that are forked or woken up onto @cpu
+ */
+static void ws_pull_readyqueue(unsigned int cpu)
+{
+	struct ws_rq *rq = ws_rq + cpu;
+	struct list_head *readyqueue = cpu_readyqueue(cpu);
+	struct process *p, *tmp;
+
+	list_for_each_entry_safe(p, tmp, readyqueue, list) {
+		list_move_tail(&p->list, &rq->queue);
+		rq->nr++;
+	}
+
+	if (rq->nr_incoming && ticks >= rq->incoming_at) {
+		list_splice_tail_init(&rq->incoming, &rq->queue);
+		rq->nr += rq->nr_incoming;
+		rq->nr_incoming = 0;
+	}
+}
+
+static void ws_balance(void)
+{
+	struct ws_rq *rq = ws_rq + this_cpu;
+	struct ws_rq *victim = NULL;
+	unsigned int nr_steal;
+
+	ws_pull_readyqueue(this_cpu);
+
+	/* Steal only when this CPU is about to go idle */
+	if (rq->nr || rq->nr_incoming) return;
+	if (current && current->status != PROCESS_WAIT &&
+			current->age < current->lifespan) return;
+
+	for (unsigned int i = 0; i < nr_cpus; i++) {
+		if (i == this_cpu) continue;
+
+		ws_pull_readyqueue(i);
+		if (!victim || ws_rq[i].nr > victim->nr) victim = ws_rq + i;
+	}
+	if (!victim || !victim->nr) return;
+
+	/* Take the half from the tail, which would be run last on the victim */
+	for (nr_steal = (victim->nr + 1) / 2; nr_steal; nr_steal--) {
+		struct process *p = list_last_entry(&victim->queue, struct process, list);
+
+		list_move(&p->list, &rq->incoming);
+		victim->nr--;
+		rq->nr_incoming++;
+		p->cpu = this_cpu;
+	}
+	rq->incoming_at = ticks + migration_cost;
+
+	ws_pull_readyqueue(this_cpu);
+}
+
+static struct process *ws_schedule(void)
+{
+	struct ws_rq *rq = ws_rq + this_cpu;
+	struct process *next = NULL;
+
+	ws_pull_readyqueue(this_cpu);
+
+	if (!current || current->status == PROCESS_WAIT || current->age == current->lifespan) {
+		goto pick_next;
+	}
+	if (!slice_expired(current)) {
+		return current;
+	}
+	if (list_empty(&rq->queue)) {
+		slice_start(current);
+		return current;
+	}
+	list_add_tail(&current->list, &rq->queue);
+	rq->nr++;
+
+pick_next:
+	if (!list_empty(&rq->queue)) {
+		next = list_first_entry(&rq->queue, struct process, list);
+		list_del_init(&next->list);
+		rq->nr--;
+		slice_start(next);
+	}
+	return next;
+}
+
+static void ws_serialize(struct checkpoint *checkpoint)
+{
+	for (unsigned int i = 0; i < nr_cpus; i++) {
+		struct ws_rq *rq = ws_rq + i;
+
+		checkpoint_list(checkpoint, &rq->queue, list);
+		checkpoint_value(checkpoint, rq->nr);
+		checkpoint_list(checkpoint, &rq->incoming, list);
+		checkpoint_value(checkpoint, rq->nr_incoming);
+		checkpoint_value(checkpoint, rq->incoming_at);
+	}
+}
+
+struct scheduler ws_scheduler = {
+	.name = "Work-stealing Round-Robin",
+	.tickless = TICKLESS_ALONE,
+	.acquire = fcfs_acquire,
+	.release = fcfs_release,
+	.acquire_shared = fcfs_acquire_shared,
+	.release_shared = fcfs_release_shared,
+	.initialize = ws_initialize,
+	.nr_ready = ws_nr_ready,
+	.balance = ws_balance,
+	.schedule = ws_schedule,
+	.serialize = ws_serialize,
+};
@@ -0,0 +1,143 @@
+/**********************************************************************
+ * Copyright (c) 2019
+ *  Sang-Hoon Kim <sanghoonkim@ajou.ac.kr>
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License version 2 as
+ * published by the Free Software Foundation.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTIABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+ * GNU General Public License for more details.
+ *
+ **********************************************************************/
+
+#ifndef __PRIO_ARRAY_H__
+#define __PRIO_ARRAY_H__
+
+#include "list_head.h"
+#include "process.h"
+#include "checkpoint.h"
+
+/**
+ * Priority-indexed ready queue, borrowed from the O(1) scheduler of Linux.
+ * Processes are kept in a list per priority value, and a bitmap tells which
+ * lists are non-empty so that the most important process is found in O(1).
+ * Processes in the same list are in the order they were enqueued, which is
+ * what the round-robin among the processes with the same priority requires.
+ */
+#define PRIO_BITS_PER_LONG	(8 * sizeof(unsigned long))
+#define PRIO_BITMAP_SIZE	((MAX_PRIO + PRIO_BITS_PER_LONG - 1) / PRIO_BITS_PER_LONG)
+
+struct prio_array {
+	unsigned int nr_active;		/* # of processes in the array */
+	unsigned long seq;			/* Sequence number for the next enqueue */
+	unsigned long bitmap[PRIO_BITMAP_SIZE];
+	struct list_head queue[MAX_PRIO];
+};
+
+static inline void prio_array_init(struct prio_array *array)
+{
+	array->nr_active = 0;
+	array->seq = 0;
+	for (unsigned int i = 0; i < PRIO_BITMAP_SIZE; i++) {
+		array->bitmap[i] = 0;
+	}
+	for (int i = 0; i < MAX_PRIO; i++) {
+		INIT_LIST_HEAD(array->queue + i);
+	}
+}
+
+/**
+ * The highest priority value among the processes in @array.
+ * -1 if @array is empty.
+ */
+static inline int prio_array_top(struct prio_array *array)
+{
+	for (int i = PRIO_BITMAP_SIZE - 1; i >= 0; i--) {
+		if (array->bitmap[i]) {
+			return i * PRIO_BITS_PER_LONG +
+					PRIO_BITS_PER_LONG - 1 - __builtin_clzl(array->bitmap[i]);
+		}
+	}
+	return -1;
+}
+
+/**
+ * The first process with the highest priority. NULL if @array is empty.
+ */
+static inline struct process *prio_array_first(struct prio_array *array)
+{
+	int prio = prio_array_top(array);
+
+	if (prio < 0) return NULL;
+
+	return list_first_entry(array->queue + prio, struct process, list);
+}
+
+/**
+ * Put @p at the tail of the list for priority @prio
+ */
+static inline void prio_array_enqueue(struct prio_array *array,
+		struct process *p, unsigned int prio)
+{
+	p->rq_prio = prio;
+	p->rq_seq = array->seq++;
+	list_add_tail(&p->list, array->queue + prio);
+	array->bitmap[prio / PRIO_BITS_PER_LONG] |= 1UL << (prio % PRIO_BITS_PER_LONG);
+	array->nr_active++;
+}
+
+static inline void prio_array_dequeue(struct prio_array *array, struct process *p)
+{
+	unsigned int prio = p->rq_prio;
+
+	list_del_init(&p->list);
+	if (list_empty(array->queue + prio)) {
+		array->bitmap[prio / PRIO_BITS_PER_LONG] &= ~(1UL << (prio % PRIO_BITS_PER_LONG));
+	}
+	array->nr_active--;
+}
+
+/**
+ * Move @p to the list for priority @prio. @p keeps its place in the enqueue
+ * order, as if it had been in the new list from the beginning.
+ */
+static inline void prio_array_requeue(struct prio_array *array,
+		struct process *p, unsigned int prio)
+{
+	struct list_head *head = array->queue + prio;
+	struct process *pos;
+
+	prio_array_dequeue(array, p);
+
+	list_for_each_entry_reverse(pos, head, list) {
+		if (pos->rq_seq < p->rq_seq) break;
+	}
+	list_add(&p->list, &pos->list);
+
+	p->rq_prio = prio;
+	array->bitmap[prio / PRIO_BITS_PER_LONG] |= 1UL << (prio % PRIO_BITS_PER_LONG);
+	array->nr_active++;
+}
+
+/**
+ * Save or restore @array as it is. @array should be empty when restoring
+ */
+static inline void prio_array_serialize(struct prio_array *array,
+		struct checkpoint *checkpoint)
+{
+	checkpoint_value(checkpoint, array->nr_active);
+	checkpoint_value(checkpoint, array->seq);
+	checkpoint_value(checkpoint, array->bitmap);
+
+	for (int i = 0; i < MAX_PRIO; i++) {
+		if (array->bitmap[i / PRIO_BITS_PER_LONG] & (1UL << (i % PRIO_BITS_PER_LONG))) {
+			checkpoint_list(checkpoint, array->queue + i, list);
+			if (list_empty(array->queue + i)) checkpoint->failed = true;
+		}
+	}
+}
+
+#endif
@@ -16,7 +16,15 @@
 #ifndef __PROCESS_H__
 #define __PROCESS_H__
 
+#include "rbtree.h"
+
 struct list_head;
+struct resource;
+
+/**
+ * Priority values range from 0 to MAX_PRIO - 1
+ */
+#define MAX_PRIO	256
 
 enum process_status {
 	PROCESS_READY,		/* Process is ready to run */
@@ -41,20 +49,58 @@ struct process {
 
 	struct list_head list;	/* list head for listing processes */
 
+	unsigned int cpu;		/* CPU whose ready queue the process belongs to */
+
 	/**
 	 * You might need following(s) to implement PIP
 	 */
 	unsigned int prio_orig;	/* The original priority of the process */
 
+	unsigned int slice_at;	/* @age when the time slice started */
+	unsigned int boosted_at;
+							/* When the process got boosted lately (MLFQ) */
+	unsigned long long pass;
+							/* Pass at age 0 of stride scheduling */
+	unsigned long long vruntime;
+							/* Virtual runtime at age 0 (CFS) */
+	struct rb_node rq_node;	/* Node in the red-black tree the process is in */
+
+	unsigned int rq_prio;	/* Priority list in prio_array the process is in */
+	unsigned long rq_seq;	/* Order of entering the prio_array */
+
+	struct resource *blocked_on;
+							/* Resource the process is blocked on.
+							   NULL if not blocked */
+	bool blocked_shared;	/* Blocked for the shared access */
+	struct list_head held;	/* Resources the process is holding */
+
 
 	/* DO NOT ACCESS FOLLOWING VARIABLES */
 	unsigned int __starts_at;	/* When to fork the process */
+	struct list_head __live;	/* Forked processes that have not exited yet */
+	unsigned long __checkpoint_id;
+								/* Index in the checkpoint being saved */
 
 	struct list_head __resources_to_acquire;
 								/* Schedule to acquire resources */
 
 	struct list_head __resources_holding;
 								/* Resources that the process is currently holding */
+
+	/* Scheduling metrics collected with -m option */
+	unsigned int __first_run_at;	/* When scheduled first. UINT_MAX if never */
+	unsigned int __blocked_at;		/* When blocked for a resource lately */
+	unsigned int __nr_blocked;		/* # of ticks blocked for resources */
+	unsigned int __nr_switches;		/* # of times being switched in */
+	unsigned int __ran_on;			/* CPU the process ran on lately. UINT_MAX if never */
+	double __entitled;				/* CPU ticks the tickets entitled the process to */
+	double __vclock_at;				/* @vclock of the CPU when got runnable lately */
+	struct list_head __blocked;		/* Blocked processes on the same resource */
+
+	/* Resource contention profile collected with -R option */
+	bool __inverted;				/* Blocked behind a lower-priority owner */
+	unsigned int __owner_pid;		/* The owner when got blocked lately */
+	unsigned int __owner_prio;
 };
 
 /**
@@ -0,0 +1,337 @@
+/* SPDX-License-Identifier: GPL-2.0-or-later */
+#ifndef _LINUX_RBTREE_H
+#define _LINUX_RBTREE_H
+
+#include <stdlib.h>
+
+/*
+ * Red-black trees, simplified from the Linux kernel.
+ *
+ * Like list_head, the tree nodes are embedded into the objects to sort, and
+ * the users walk down the tree by themselves to find where to insert a node;
+ *
+ *	struct rb_node **link = &root->rb_node, *parent = NULL;
+ *
+ *	while (*link) {
+ *		parent = *link;
+ *		if (key < rb_entry(parent, struct thing, node)->key)
+ *			link = &parent->rb_left;
+ *		else
+ *			link = &parent->rb_right;
+ *	}
+ *	rb_link_node(&thing->node, parent, link);
+ *	rb_insert_color(&thing->node, root);
+ *
+ * The color is kept in a separate field rather than in the low bit of the
+ * parent pointer to keep the code simple.
+ */
+
+#define RB_RED		0
+#define RB_BLACK	1
+
+struct rb_node {
+	struct rb_node *rb_parent;
+	struct rb_node *rb_right;
+	struct rb_node *rb_left;
+	int rb_color;
+};
+
+struct rb_root {
+	struct rb_node *rb_node;
+};
+
+/*
+ * Leftmost-cached rbtrees.
+ *
+ * The leftmost node is cached so that rb_first_cached() finds the smallest
+ * node in O(1), which is handy for the trees used as priority queues.
+ */
+struct rb_root_cached {
+	struct rb_root rb_root;
+	struct rb_node *rb_leftmost;
+};
+
+#define RB_ROOT			(struct rb_root) { NULL, }
+#define RB_ROOT_CACHED	(struct rb_root_cached) { { NULL, }, NULL }
+
+#define rb_entry(ptr, type, member) \
+	((type *)((char *)(ptr) - __builtin_offsetof(type, member)))
+
+#define RB_EMPTY_ROOT(root)		((root)->rb_node == NULL)
+
+#define rb_first_cached(root)	((root)->rb_leftmost)
+
+static inline int rb_is_red(struct rb_node *node)
+{
+	return node && node->rb_color == RB_RED;
+}
+
+static inline int rb_is_black(struct rb_node *node)
+{
+	return !rb_is_red(node);
+}
+
+static inline void rb_link_node(struct rb_node *node, struct rb_node *parent,
+				struct rb_node **rb_link)
+{
+	node->rb_parent = parent;
+	node->rb_color = RB_RED;
+	node->rb_left = node->rb_right = NULL;
+
+	*rb_link = node;
+}
+
+static inline void __rb_change_child(struct rb_node *old, struct rb_node *new,
+				     struct rb_node *parent, struct rb_root *root)
+{
+	if (parent) {
+		if (parent->rb_left == old)
+			parent->rb_left = new;
+		else
+			parent->rb_right = new;
+	} else {
+		root->rb_node = new;
+	}
+}
+
+static inline void __rb_rotate_left(struct rb_node *node, struct rb_root *root)
+{
+	struct rb_node *right = node->rb_right;
+
+	node->rb_right = right->rb_left;
+	if (right->rb_left)
+		right->rb_left->rb_parent = node;
+
+	right->rb_parent = node->rb_parent;
+	__rb_change_child(node, right, node->rb_parent, root);
+
+	right->rb_left = node;
+	node->rb_parent = right;
+}
+
+static inline void __rb_rotate_right(struct rb_node *node, struct rb_root *root)
+{
+	struct rb_node *left = node->rb_left;
+
+	node->rb_left = left->rb_right;
+	if (left->rb_right)
+		left->rb_right->rb_parent = node;
+
+	left->rb_parent = node->rb_parent;
+	__rb_change_child(node, left, node->rb_parent, root);
+
+	left->rb_right = node;
+	node->rb_parent = left;
+}
+
+/*
+ * Rebalance the tree after @node is linked with rb_link_node()
+ */
+static inline void rb_insert_color(struct rb_node *node, struct rb_root *root)
+{
+	struct rb_node *parent, *gparent, *uncle;
+
+	while ((parent = node->rb_parent) && parent->rb_color == RB_RED) {
+		gparent = parent->rb_parent;
+
+		if (parent == gparent->rb_left) {
+			uncle = gparent->rb_right;
+			if (rb_is_red(uncle)) {
+				uncle->rb_color = RB_BLACK;
+				parent->rb_color = RB_BLACK;
+				gparent->rb_color = RB_RED;
+				node = gparent;
+				continue;
+			}
+
+			if (parent->rb_right == node) {
+				__rb_rotate_left(parent, root);
+				node = parent;
+				parent = node->rb_parent;
+			}
+
+			parent->rb_color = RB_BLACK;
+			gparent->rb_color = RB_RED;
+			__rb_rotate_right(gparent, root);
+		} else {
+			uncle = gparent->rb_left;
+			if (rb_is_red(uncle)) {
+				uncle->rb_color = RB_BLACK;
+				parent->rb_color = RB_BLACK;
+				gparent->rb_color = RB_RED;
+				node = gparent;
+				continue;
+			}
+
+			if (parent->rb_left == node) {
+				__rb_rotate_right(parent, root);
+				node = parent;
+				parent = node->rb_parent;
+			}
+
+			parent->rb_color = RB_BLACK;
+			gparent->rb_color = RB_RED;
+			__rb_rotate_left(gparent, root);
+		}
+	}
+
+	root->rb_node->rb_color = RB_BLACK;
+}
+
+static inline void __rb_erase_color(struct rb_node *node, struct rb_node *parent,
+				    struct rb_root *root)
+{
+	struct rb_node *sibling;
+
+	while (rb_is_black(node) && node != root->rb_node) {
+		if (parent->rb_left == node) {
+			sibling = parent->rb_right;
+			if (rb_is_red(sibling)) {
+				sibling->rb_color = RB_BLACK;
+				parent->rb_color = RB_RED;
+				__rb_rotate_left(parent, root);
+				sibling = parent->rb_right;
+			}
+			if (rb_is_black(sibling->rb_left) &&
+			    rb_is_black(sibling->rb_right)) {
+				sibling->rb_color = RB_RED;
+				node = parent;
+				parent = node->rb_parent;
+				continue;
+			}
+			if (rb_is_black(sibling->rb_right)) {
+				sibling->rb_left->rb_color = RB_BLACK;
+				sibling->rb_color = RB_RED;
+				__rb_rotate_right(sibling, root);
+				sibling = parent->rb_right;
+			}
+			sibling->rb_color = parent->rb_color;
+			parent->rb_color = RB_BLACK;
+			sibling->rb_right->rb_color = RB_BLACK;
+			__rb_rotate_left(parent, root);
+		} else {
+			sibling = parent->rb_left;
+			if (rb_is_red(sibling)) {
+				sibling->rb_color = RB_BLACK;
+				parent->rb_color = RB_RED;
+				__rb_rotate_right(parent, root);
+				sibling = parent->rb_left;
+			}
+			if (rb_is_black(sibling->rb_left) &&
+			    rb_is_black(sibling->rb_right)) {
+				sibling->rb_color = RB_RED;
+				node = parent;
+				parent = node->rb_parent;
+				continue;
+			}
+			if (rb_is_black(sibling->rb_left)) {
+				sibling->rb_right->rb_color = RB_BLACK;
+				sibling->rb_color = RB_RED;
+				__rb_rotate_left(sibling, root);
+				sibling = parent->rb_left;
+			}
+			sibling->rb_color = parent->rb_color;
+			parent->rb_color = RB_BLACK;
+			sibling->rb_left->rb_color = RB_BLACK;
+			__rb_rotate_right(parent, root);
+		}
+		node = root->rb_node;
+		break;
+	}
+
+	if (node)
+		node->rb_color = RB_BLACK;
+}
+
+static inline void rb_erase(struct rb_node *node, struct rb_root *root)
+{
+	struct rb_node *child, *parent;
+	int color;
+
+	if (!node->rb_left) {
+		child = node->rb_right;
+	} else if (!node->rb_right) {
+		child = node->rb_left;
+	} else {
+		/* Replace @node with its successor, which has no left child */
+		struct rb_node *old = node, *left;
+
+		node = node->rb_right;
+		while ((left = node->rb_left) != NULL)
+			node = left;
+
+		__rb_change_child(old, node, old->rb_parent, root);
+
+		child = node->rb_right;
+		parent = node->rb_parent;
+		color = node->rb_color;
+
+		if (parent == old) {
+			parent = node;
+		} else {
+			if (child)
+				child->rb_parent = parent;
+			parent->rb_left = child;
+
+			node->rb_right = old->rb_right;
+			old->rb_right->rb_parent = node;
+		}
+
+		node->rb_parent = old->rb_parent;
+		node->rb_color = old->rb_color;
+		node->rb_left = old->rb_left;
+		old->rb_left->rb_parent = node;
+
+		goto color;
+	}
+
+	parent = node->rb_parent;
+	color = node->rb_color;
+
+	if (child)
+		child->rb_parent = parent;
+	__rb_change_child(node, child, parent, root);
+
+color:
+	if (color == RB_BLACK)
+		__rb_erase_color(child, parent, root);
+}
+
+/*
+ * The node following @node in the sort order. NULL if @node is the last
+ */
+static inline struct rb_node *rb_next(const struct rb_node *node)
+{
+	struct rb_node *parent;
+
+	if (node->rb_right) {
+		node = node->rb_right;
+		while (node->rb_left)
+			node = node->rb_left;
+		return (struct rb_node *)node;
+	}
+
+	while ((parent = node->rb_parent) && node == parent->rb_right)
+		node = parent;
+
+	return parent;
+}
+
+static inline void rb_insert_color_cached(struct rb_node *node,
+					  struct rb_root_cached *root,
+					  int leftmost)
+{
+	if (leftmost)
+		root->rb_leftmost = node;
+	rb_insert_color(node, &root->rb_root);
+}
+
+static inline void rb_erase_cached(struct rb_node *node,
+				   struct rb_root_cached *root)
+{
+	if (root->rb_leftmost == node)
+		root->rb_leftmost = rb_next(node);
+	rb_erase(node, &root->rb_root);
+}
+
+#endif	/* _LINUX_RBTREE_H */
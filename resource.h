@@ -19,13 +19,26 @@
 struct process;
 struct list_head;
 
+/**
+ * Kinds of resources. Resources are mutexes unless declared otherwise in the
+ * script with "semaphore [resource id] [capacity]" or "rwlock [resource id]".
+ */
+enum resource_kind {
+	RESOURCE_MUTEX = 0,		/* Held by one process at a time */
+	RESOURCE_SEMAPHORE,		/* Held by up to @capacity processes at a time */
+	RESOURCE_RWLOCK,		/* Held by one writer, or by readers that
+							   acquire the resource in the shared mode */
+};
+
 /**
  * Resources in the system.
  */
 struct resource {
 	/**
 	 * The owner process of this resource. NULL implies the resource is free
-	 * whereas non-NULL implies @owner process owns this resource
+	 * whereas non-NULL implies @owner process owns this resource. Semaphores
+	 * and rwlocks held in the shared mode have no single owner; see
+	 * @nr_holders instead.
 	 */
 	struct process *owner;
 
@@ -33,11 +46,30 @@ struct resource {
 	 * list head to list processes that are wanting for the resource
 	 */
 	struct list_head waitqueue;
+
+	enum resource_kind kind;
+	unsigned int capacity;	/* # of units of a semaphore. 1 for others */
+
+	/**
+	 * # of processes holding the resource, maintained by the framework. It
+	 * is increased when acquire() returns true, and decreased right before
+	 * release() is called. So release() sees the holders other than @current
+	 */
+	unsigned int nr_holders;
+
+	/**
+	 * The priority ceiling of the resource, which is the highest initial
+	 * priority of the processes acquiring the resource in the script. It is
+	 * set by the framework when the script is loaded
+	 */
+	unsigned int ceiling;
 };
 
 /**
- * This system has 32 different resources. It is defined in pa2.c as an array of
- * struct resource (i.e., struct resource resources[NR_RESOURCES];)
+ * This system has @nr_resources different resources, which is NR_RESOURCES
+ * unless the script uses more or -n option says otherwise. It is defined in
+ * sched.c as an array of struct resource (i.e., struct resource *resources;)
+ * sized when the script is loaded, before scheduler.initialize() is called.
  */
 #define NR_RESOURCES 32
 
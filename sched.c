@@ -16,56 +16,360 @@
 /*====================================================================*/
 /*          ******        DO NOT MODIFY THIS FILE        ******       */
 
+#define _DEFAULT_SOURCE	/* madvise() */
+
 #include <stdio.h>
 #include <stdlib.h>
 #include <string.h>
+#include <limits.h>
 #include <assert.h>
 #include <unistd.h>
 #include <getopt.h>
+#include <pthread.h>
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <sys/resource.h>
+#include <time.h>
 
 #include "types.h"
 #include "list_head.h"
+#include "rbtree.h"
 
-#include "parser.h"
 #include "process.h"
 #include "resource.h"
+#include "arena.h"
+#include "trace.h"
+#include "workload.h"
+#include "instrument.h"
+#include "checkpoint.h"
 
 #include "sched.h"
 
+/**
+ * A simulation to run; which script to simulate with which scheduler, and
+ * where to put the messages and the trace. The state of a simulation is
+ * thread-local (__thread) so that simulations can run in parallel in the
+ * batch mode, one simulation per thread at a time.
+ */
+struct simulation {
+	char *scriptfile;
+	struct scheduler *sched;
+	FILE *out;		/* Briefings and reports (stdout by default) */
+	FILE *trace;	/* Scheduling events (stderr by default). NULL to discard */
+	bool binary;	/* Write @trace in the binary format */
+
+	/* Workload image shared with the other simulations, not to be freed */
+	char *image;
+	size_t image_size;
+
+	/* Where to keep the results instead of reporting them (--compare) */
+	struct comparison *result;
+};
+
+static __thread struct simulation *__sim;
+static __thread struct trace __trace;
+
 /**
  * List head to hold the processes ready to run
  */
-LIST_HEAD(readyqueue);
+__thread struct list_head readyqueue;
 
 /**
  * The process that is currently running
  */
-struct process *current = NULL;
+__thread struct process *current = NULL;
 
 /**
  * Number of generated ticks since the simulator was started
  */
-unsigned int ticks = 0;
+__thread unsigned int ticks = 0;
+
+/**
+ * Number of CPUs in the system, and the CPU being simulated at the moment.
+ * @current and @readyqueue always belong to @this_cpu; those of the other
+ * CPUs are parked in @cpus[] until the CPU is simulated again.
+ */
+unsigned int nr_cpus = 1;
+__thread unsigned int this_cpu = 0;
+
+static __thread struct cpu {
+	struct process *current;
+	struct list_head readyqueue;
+	unsigned int nr_idle;	/* # of ticks the CPU has been idle */
+	unsigned int switching;	/* # of ticks left to switch to @current */
+	unsigned int nr_switching;
+							/* # of ticks the CPU has spent for switching */
+
+	/**
+	 * Share accounting for proportional-share policies. @vclock advances by
+	 * 1 / @nr_tickets on each tick, so a runnable process is entitled to its
+	 * tickets times the advance while it is runnable
+	 */
+	double vclock;
+	unsigned long nr_tickets;	/* Tickets of the runnable processes */
+	unsigned int vclock_at;		/* When @vclock was advanced lately */
+} cpus[MAX_NR_CPUS];
+
+/**
+ * Ticks to take for migrating a process to another CPU. Set with -M option
+ */
+unsigned int migration_cost = 0;
+
+/**
+ * Ticks in a time slice of the round-robin and priority schedulers. Set with
+ * -Q option
+ */
+unsigned int quantum = 1;
+
+/**
+ * Ticks the CPU takes to switch to another process, and more ticks to take if
+ * the process ran on another CPU lately. Set with -x and -X options. The CPU
+ * does not run processes nor call schedule() while switching
+ */
+static unsigned int switch_cost = 0;
+static unsigned int migrate_switch_cost = 0;
+
+/**
+ * Resources in the system. The table is sized after loading the script;
+ * @max_resources if specified with -n option, or large enough to cover the
+ * resources in the script otherwise. It is never smaller than NR_RESOURCES
+ * unless specified.
+ */
+__thread struct resource *resources;
+__thread unsigned int nr_resources;
+static unsigned int max_resources = 0;
 
 /**
- * Resources in the system.
+ * Resource ids beyond this would be rather a typo than a workload
  */
-struct resource resources[NR_RESOURCES];
+#define MAX_NR_RESOURCES	(1U << 24)
+
+/**
+ * Bitmaps over the resource table. Resources are marked active on the first
+ * acquisition attempt, and only the active resources are listed in the order
+ * of their ids to report the status of resources.
+ */
+#define BITS_PER_LONG		(8 * sizeof(unsigned long))
+#define BITS_TO_LONGS(nr)	(((nr) + BITS_PER_LONG - 1) / BITS_PER_LONG)
+
+static inline bool __test_bit(const unsigned long *bitmap, unsigned int nr)
+{
+	return (bitmap[nr / BITS_PER_LONG] >> (nr % BITS_PER_LONG)) & 1;
+}
+
+static inline void __set_bit(unsigned long *bitmap, unsigned int nr)
+{
+	bitmap[nr / BITS_PER_LONG] |= 1UL << (nr % BITS_PER_LONG);
+}
+
+static inline void __clear_bit(unsigned long *bitmap, unsigned int nr)
+{
+	bitmap[nr / BITS_PER_LONG] &= ~(1UL << (nr % BITS_PER_LONG));
+}
+
+static __thread unsigned long *__resources_shared;	/* Held in the shared mode */
+static __thread unsigned long *__resources_active;
+static __thread unsigned int *__active_resources;
+static __thread unsigned int __nr_active_resources;
 
 /**
  * Following code is to maintain the simulator itself.
  */
 struct resource_schedule {
-	int resource_id;
-	int at;
-	int duration;
+	unsigned int resource_id;
+	unsigned int at;
+	unsigned int duration;
+	unsigned int acquired_at;
+	unsigned int release_at;	/* The age to release the resource at */
+	bool shared;				/* Acquire in the shared mode */
 	struct list_head list;
 };
 
-static LIST_HEAD(__forkqueue);
+static __thread struct list_head __forkqueue;
+static __thread unsigned int __nr_forked;
+
+/**
+ * Process script reader. The script is mapped into the memory and scanned
+ * once; tokens are never copied nor NUL-terminated.
+ */
+struct script {
+	const char *filename;
+	const char *pos;		/* Next character to scan */
+	const char *end;
+	unsigned int line;		/* Line number of @pos */
+};
+
+/**
+ * Processes that are not brought into the fork queue yet. They are fetched
+ * from the workload image if the script is precompiled, or from the rest of
+ * the script in the streaming mode, shortly before they are forked.
+ */
+static __thread struct workload {
+	char *image;			/* The workload image or the script */
+	size_t size;
+	bool mapped;			/* @image is mmap()ed, otherwise malloc()ed */
+	bool shared;			/* @image is owned by someone else */
+	bool precompiled;
+	bool exhausted;			/* All processes have been fetched */
+
+	/* Precompiled workload image */
+	const struct workload_process *next;	/* Next process to fetch */
+	const struct workload_process *end;
+	const struct workload_schedule *schedules;
+	uint64_t nr_schedules;
+
+	/* Script in the streaming mode */
+	struct script script;
+	unsigned int last_starts_at;
+
+	unsigned int nr_resources;	/* The largest resource id used + 1 */
+
+	/* Resources declared in the script other than mutexes */
+	struct workload_resource *declarations;
+	unsigned int nr_declarations;
+
+	/* The pages below these are dropped in the streaming mode */
+	const char *dropped;
+	const char *schedules_dropped;
+} __workload;
+
+#define WORKLOAD_DROP_SIZE	(1 << 20)
+
+/**
+ * Processes and resource schedules are allocated from arenas, laid out in the
+ * order of the script. They are freed all at once when the simulation is over.
+ */
+static __thread struct arena __process_arena;
+static __thread struct arena __resource_schedule_arena;
+
+/**
+ * Streaming mode. True if the program was started with -l option. The script
+ * is read as the simulation goes on, so it should be sorted by the fork time.
+ * Exited processes and released resource schedules are recycled through the
+ * free lists to keep the memory bounded by the live processes.
+ */
+static bool streaming = false;
+static __thread struct list_head __free_processes;
+static __thread struct list_head __free_resource_schedules;
 
 bool quiet = false;
 
+/**
+ * Event-driven simulation. True if the program was started with -e option.
+ * Uneventful ticks are fast-forwarded instead of being simulated one by one,
+ * and with -z option, the fast-forwarded ticks are printed in a single line.
+ */
+static bool event_driven = false;
+static bool compress_trace = false;
+
+/**
+ * Checkpoints. With --checkpoint, the state of the simulation is written into
+ * @checkpoint_file at tick @checkpoint_at (--checkpoint-at) and on every
+ * @checkpoint_every ticks (--checkpoint-every), replacing the previous one.
+ * The simulation is resumed from @resume_file with --resume. Processes that
+ * are forked and not exited yet are kept in __live_processes to be saved.
+ */
+static char *checkpoint_file = NULL;
+static unsigned int checkpoint_at = UINT_MAX;
+static unsigned int checkpoint_every = 0;
+static char *resume_file = NULL;
+static __thread unsigned int __next_checkpoint_at;
+static __thread struct list_head __live_processes;
+
+/**
+ * Statistics of the simulator itself. Reported with -t option
+ */
+static bool show_stats = false;
+static __thread struct {
+	unsigned long long simulation_ns;	/* Time spent in __do_simulation() */
+	unsigned long long schedule_ns;		/* Time spent in sched->schedule() */
+	unsigned long nr_schedules;
+	unsigned long nr_allocs;			/* # of chunks allocated for the arenas */
+} __stats;
+
+/**
+ * Per-process scheduling metrics. Collected with -m option when processes
+ * exit, and reported at the end of the simulation. Blocked processes are kept
+ * in __blocked[] of the resource they wait for to tell when they are woken up.
+ */
+static bool show_metrics = false;
+
+struct metrics {
+	unsigned int pid;
+	unsigned int arrival;
+	unsigned int first_run;
+	unsigned int completion;
+	unsigned int lifespan;
+	unsigned int nr_blocked;
+	unsigned int nr_switches;
+	unsigned int tickets;
+	double entitled;
+};
+
+static __thread struct metrics *__metrics;
+static __thread unsigned long __nr_metrics;
+static __thread unsigned long __max_metrics;
+static __thread struct list_head *__blocked;
+
+/**
+ * Resource contention profile. Collected with -R option and reported at the
+ * end of the simulation along with the longest priority inversions, where a
+ * process is blocked behind an owner with a lower original priority.
+ */
+static bool profile_resources = false;
+
+static __thread struct resource_profile {
+	unsigned long nr_acquisitions;
+	unsigned long nr_contended;		/* # of acquisitions got blocked */
+	unsigned long long hold_ticks;
+	unsigned long long wait_ticks;
+	unsigned int max_wait;
+	unsigned int nr_waiters;
+	unsigned int max_waiters;
+	unsigned int waiters_since;		/* When @nr_waiters is changed lately */
+	unsigned long long waiters_ticks;	/* Integral of @nr_waiters over ticks */
+} *__resource_profiles;
+
+#define NR_TOP_INVERSIONS	10
+
+static __thread struct inversion {
+	unsigned int resource_id;
+	unsigned int pid;
+	unsigned int prio;
+	unsigned int owner_pid;
+	unsigned int owner_prio;
+	unsigned int since;
+	unsigned int duration;
+} __inversions[NR_TOP_INVERSIONS];	/* Sorted by @duration */
+static __thread unsigned int __nr_inversions;
+static __thread unsigned long __nr_total_inversions;
+static __thread unsigned long long __inversion_ticks;	/* Sum of the durations */
+
+/**
+ * Results of a simulation kept to compare the schedulers with --compare
+ */
+struct comparison {
+	unsigned int ticks;
+	struct metrics *metrics;	/* Sorted by the pid */
+	unsigned long nr_metrics;
+	unsigned long nr_inversions;
+	unsigned long long inversion_ticks;
+};
+
+static inline bool __track_blocking(void)
+{
+	return show_metrics || profile_resources;
+}
+
+static inline unsigned long long __now_ns(void)
+{
+	struct timespec ts;
+
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+	return ts.tv_sec * 1000000000ULL + ts.tv_nsec;
+}
+
 static const char * __process_status_sz[] = {
 	"RDY",
 	"RUN",
@@ -82,387 +386,3013 @@ extern struct scheduler srtf_scheduler;
 extern struct scheduler rr_scheduler;
 extern struct scheduler prio_scheduler;
 extern struct scheduler pip_scheduler;
+extern struct scheduler ceiling_scheduler;
+extern struct scheduler mlfq_scheduler;
+extern struct scheduler stride_scheduler;
+extern struct scheduler lottery_scheduler;
+extern struct scheduler cfs_scheduler;
+extern struct scheduler ws_scheduler;
+
+/**
+ * Option letters to pick the schedulers
+ */
+static struct {
+	int option;
+	struct scheduler *sched;
+} __schedulers[] = {
+	{ 'f', &fifo_scheduler },
+	{ 's', &sjf_scheduler },
+	{ 'S', &srtf_scheduler },
+	{ 'r', &rr_scheduler },
+	{ 'p', &prio_scheduler },
+	{ 'i', &pip_scheduler },
+	{ 'C', &ceiling_scheduler },
+	{ 'F', &mlfq_scheduler },
+	{ 'd', &stride_scheduler },
+	{ 'L', &lottery_scheduler },
+	{ 'V', &cfs_scheduler },
+	{ 'w', &ws_scheduler },
+};
+#define NR_SCHEDULERS	(int)(sizeof(__schedulers) / sizeof(__schedulers[0]))
+
+static __thread struct scheduler *sched;
+
+static int __compare_resource_id(const void *a, const void *b)
+{
+	unsigned int x = *(const unsigned int *)a;
+	unsigned int y = *(const unsigned int *)b;
+
+	return x < y ? -1 : x > y;
+}
+
+/**
+ * Sort the active resources by their ids. They are activated mostly in order,
+ * and sorted ones remain sorted, so this is cheap to call for each report.
+ */
+static void __sort_active_resources(void)
+{
+	unsigned int i;
+
+	for (i = 1; i < __nr_active_resources; i++) {
+		if (__active_resources[i - 1] > __active_resources[i]) break;
+	}
+	if (i >= __nr_active_resources) return;
+
+	qsort(__active_resources, __nr_active_resources, sizeof(*__active_resources),
+			__compare_resource_id);
+}
+
+/**
+ * Mark @resource_id active if it is used for the first time
+ */
+static inline void __activate_resource(unsigned int resource_id)
+{
+	if (__test_bit(__resources_active, resource_id)) return;
 
-static struct scheduler *sched = &fifo_scheduler;
+	__set_bit(__resources_active, resource_id);
+	__active_resources[__nr_active_resources++] = resource_id;
+}
 
 void dump_status(void)
 {
 	struct process *p;
 
-	printf("***** CURRENT *********\n");
+	fprintf(__sim->out, "***** CURRENT *********\n");
 	if (current) {
-		printf("%2d (%s): %d + %d/%d at %d\n",
+		fprintf(__sim->out, "%2d (%s): %d + %d/%d at %d\n",
 				current->pid, __process_status_sz[current->status],
 				current->__starts_at,
 				current->age, current->lifespan, current->prio);
 	}
 
-	printf("***** READY QUEUE *****\n");
+	fprintf(__sim->out, "***** READY QUEUE *****\n");
 	list_for_each_entry(p, &readyqueue, list) {
-		printf("%2d (%s): %d + %d/%d at %d\n",
+		fprintf(__sim->out, "%2d (%s): %d + %d/%d at %d\n",
 				p->pid, __process_status_sz[p->status],
 				p->__starts_at, p->age, p->lifespan, p->prio);
 	}
 
-	printf("***** RESOURCES *******\n");
-	for (int i = 0; i < NR_RESOURCES; i++) {
-		struct resource *r = resources + i;;
-		if (r->owner || !list_empty(&r->waitqueue)) {
-			printf("%2d: owned by ", i);
+	fprintf(__sim->out, "***** RESOURCES *******\n");
+	__sort_active_resources();
+	for (unsigned int j = 0; j < __nr_active_resources; j++) {
+		unsigned int i = __active_resources[j];
+		struct resource *r = resources + i;
+		if (r->owner || r->nr_holders || !list_empty(&r->waitqueue)) {
+			fprintf(__sim->out, "%2d: owned by ", i);
 			if (r->owner) {
-				printf("%d\n", r->owner->pid);
+				fprintf(__sim->out, "%d\n", r->owner->pid);
+			} else if (r->nr_holders) {
+				fprintf(__sim->out, "%d processes\n", r->nr_holders);
 			} else {
-				printf("no one\n");
+				fprintf(__sim->out, "no one\n");
 			}
 
 			list_for_each_entry(p, &r->waitqueue, list) {
-				printf("    %d is waiting\n", p->pid);
+				fprintf(__sim->out, "    %d is waiting\n", p->pid);
 			}
 		}
 	}
-	printf("\n\n");
+	fprintf(__sim->out, "\n\n");
 
 	return;
 }
 
-#define __print_event(pid, string, args...) do { \
-	fprintf(stderr, "%3d: ", ticks); \
-	for (int i = 0; i < pid; i++) { \
-		fprintf(stderr, "    "); \
-	} \
-	fprintf(stderr, string "\n", ##args); \
-} while (0);
-
-static inline bool strmatch(char * const str, const char *expect)
+/**
+ * Put an event into the trace of this simulation
+ */
+static inline void __print_event(enum trace_kind kind, unsigned int pid, unsigned int arg)
 {
-	return (strlen(str) == strlen(expect)) && (strncmp(str, expect, strlen(expect)) == 0);
+	struct trace_record r = {
+		.tick = ticks,
+		.pid = pid,
+		.arg = arg,
+		.cpu = this_cpu,
+		.kind = kind,
+	};
+
+	if (!__sim->trace) return;
+	trace_write(&__trace, &r);
 }
 
-static void __briefing_process(struct process *p)
+static struct process *__alloc_process(void)
 {
-	struct resource_schedule *rs;
+	struct process *p;
 
-	if (quiet) return;
+	if (list_empty(&__free_processes)) {
+		p = arena_alloc(&__process_arena, sizeof(*p));
+	} else {
+		p = list_first_entry(&__free_processes, struct process, list);
+		list_del(&p->list);
+		memset(p, 0x00, sizeof(*p));
+	}
 
-	printf("- Process %d: Forked at tick %d and run for %d tick%s with initial priority %d\n",
-				p->pid, p->__starts_at, p->lifespan,
-				p->lifespan >= 2 ? "s" : "", p->prio);
+	INIT_LIST_HEAD(&p->list);
+	INIT_LIST_HEAD(&p->__resources_to_acquire);
+	INIT_LIST_HEAD(&p->__resources_holding);
+	INIT_LIST_HEAD(&p->__blocked);
+	INIT_LIST_HEAD(&p->__live);
+	p->__first_run_at = UINT_MAX;
+	p->__ran_on = UINT_MAX;
 
-	list_for_each_entry(rs, &p->__resources_to_acquire, list) {
-		printf("    Acquire resource %d at %d for %d\n", rs->resource_id, rs->at, rs->duration);
-	}
+	return p;
 }
 
-static int __load_script(char * const filename)
+static void __free_process(struct process *p)
 {
-	char line[256];
-	struct process *p = NULL;
-
-	FILE *file = fopen(filename, "r");
-	while (fgets(line, sizeof(line), file)) {
-		char *tokens[32] = { NULL };
-		int nr_tokens;
-
-		parse_command(line, &nr_tokens, tokens);
+	if (streaming) list_add(&p->list, &__free_processes);
+}
 
-		if (nr_tokens == 0) continue;
+static struct resource_schedule *__alloc_resource_schedule(void)
+{
+	struct resource_schedule *rs;
 
-		if (strmatch(tokens[0], "process")) {
-			assert(nr_tokens == 2);
-			/* Start processor description */
-			p = malloc(sizeof(*p));
-			memset(p, 0x00, sizeof(*p));
+	if (list_empty(&__free_resource_schedules)) {
+		return arena_alloc(&__resource_schedule_arena, sizeof(*rs));
+	}
 
-			p->pid = atoi(tokens[1]);
+	rs = list_first_entry(&__free_resource_schedules, struct resource_schedule, list);
+	list_del(&rs->list);
+	memset(rs, 0x00, sizeof(*rs));
 
-			INIT_LIST_HEAD(&p->list);
-			INIT_LIST_HEAD(&p->__resources_to_acquire);
-			INIT_LIST_HEAD(&p->__resources_holding);
+	return rs;
+}
 
-			continue;
-		} else if (strmatch(tokens[0], "end")) {
-			/* End of process description */
-			struct resource_schedule *rs;
-			assert(p);
+static void __free_resource_schedule(struct resource_schedule *rs)
+{
+	if (streaming) list_add(&rs->list, &__free_resource_schedules);
+}
 
-			list_add_tail(&p->list, &__forkqueue);
+static void __briefing(unsigned int pid, unsigned int starts_at,
+		unsigned int lifespan, unsigned int prio)
+{
+	fprintf(__sim->out, "- Process %d: Forked at tick %d and run for %d tick%s with initial priority %d\n",
+				pid, starts_at, lifespan, lifespan >= 2 ? "s" : "", prio);
+}
 
-			__briefing_process(p);
-			p = NULL;
+static void __briefing_acquire(unsigned int resource_id, unsigned int at,
+		unsigned int duration, bool shared)
+{
+	fprintf(__sim->out, "    Acquire resource %d at %d for %d%s\n", resource_id, at, duration,
+			shared ? " in the shared mode" : "");
+}
 
-			continue;
-		}
+static void __briefing_resource(const struct workload_resource *wr)
+{
+	if (wr->kind == RESOURCE_SEMAPHORE) {
+		fprintf(__sim->out, "- Resource %d: Semaphore with %d unit%s\n",
+				wr->resource_id, wr->capacity, wr->capacity >= 2 ? "s" : "");
+	} else {
+		fprintf(__sim->out, "- Resource %d: Reader-writer lock\n", wr->resource_id);
+	}
+}
 
-		if (strmatch(tokens[0], "lifespan")) {
-			assert(nr_tokens == 2);
-			p->lifespan = atoi(tokens[1]);
-		} else if (strmatch(tokens[0], "prio")) {
-			assert(nr_tokens == 2);
-			p->prio = p->prio_orig = atoi(tokens[1]);
-		} else if (strmatch(tokens[0], "start")) {
-			assert(nr_tokens == 2);
-			p->__starts_at = atoi(tokens[1]);
-		} else if (strmatch(tokens[0], "acquire")) {
-			struct resource_schedule *rs;
-			assert(nr_tokens == 4);
+static void __briefing_process(struct process *p)
+{
+	struct resource_schedule *rs;
 
-			rs = malloc(sizeof(*rs));
+	if (quiet) return;
 
-			rs->resource_id = atoi(tokens[1]);
-			rs->at = atoi(tokens[2]);
-			rs->duration = atoi(tokens[3]);
+	__briefing(p->pid, p->__starts_at, p->lifespan, p->prio);
 
-			list_add_tail(&rs->list, &p->__resources_to_acquire);
-		} else {
-			fprintf(stderr, "Unknown property %s\n", tokens[0]);
-			return false;
-		}
+	list_for_each_entry(rs, &p->__resources_to_acquire, list) {
+		__briefing_acquire(rs->resource_id, rs->at, rs->duration, rs->shared);
 	}
-	fclose(file);
-	if (!quiet) printf("\n");
-	return true;
 }
 
-
 /**
- * Fork process on schedule
+ * Merge two NULL-terminated lists of processes sorted by the fork time.
+ * Processes in @a come first when they are to be forked at the same tick.
  */
-static int __fork_on_schedule()
+static struct list_head *__merge_forkqueue(struct list_head *a, struct list_head *b)
 {
-	int nr_forked = 0;
-	struct process *p, *tmp;
-	list_for_each_entry_safe(p, tmp, &__forkqueue, list) {
-		if (p->__starts_at <= ticks) {
-			list_move_tail(&p->list, &readyqueue);
-			p->status = PROCESS_READY;
-			__print_event(p->pid, "N");
-			if (sched->forked) sched->forked(p);
-			nr_forked++;
+	struct list_head head, *tail = &head;
+
+	while (a && b) {
+		if (list_entry(a, struct process, list)->__starts_at <=
+				list_entry(b, struct process, list)->__starts_at) {
+			tail->next = a;
+			a = a->next;
+		} else {
+			tail->next = b;
+			b = b->next;
 		}
+		tail = tail->next;
 	}
-	return nr_forked;
+	tail->next = a ? a : b;
+
+	return head.next;
 }
 
 /**
- * Exit the process
+ * Sort the fork queue by the fork time. The sort is stable so that processes
+ * starting at the same tick are forked in the order of the script.
  */
-static void __exit_process(struct process *p)
+static void __sort_forkqueue(void)
 {
-	/* Make sure the process is not attached to some list head */
-	assert(list_empty(&p->list));
+	struct list_head *pending[32] = { NULL };
+	struct list_head *list, *next, *prev;
+	int level;
 
-	/* Make sure the process is not holding any resource */
-	assert(list_empty(&p->__resources_holding));
+	if (list_empty(&__forkqueue)) return;
 
-	/* Make sure there is no pending resource to acquire */
-	assert(list_empty(&p->__resources_to_acquire));
+	/* Break the circular list and merge runs of 2^n processes bottom-up */
+	__forkqueue.prev->next = NULL;
+	for (list = __forkqueue.next; list; list = next) {
+		next = list->next;
+		list->next = NULL;
 
-	if (sched->exiting) sched->exiting(p);
+		for (level = 0; level < 31 && pending[level]; level++) {
+			list = __merge_forkqueue(pending[level], list);
+			pending[level] = NULL;
+		}
+		pending[level] = __merge_forkqueue(pending[level], list);
+	}
 
-	__print_event(p->pid, "X");
+	list = NULL;
+	for (level = 0; level < 32; level++) {
+		list = __merge_forkqueue(pending[level], list);
+	}
 
-	free(p);
+	/* Restore the backward links */
+	prev = &__forkqueue;
+	for (; list; list = list->next) {
+		prev->next = list;
+		list->prev = prev;
+		prev = list;
+	}
+	prev->next = &__forkqueue;
+	__forkqueue.prev = prev;
 }
 
+#define __script_error(s, fmt, ...) \
+	fprintf(stderr, "%s:%u: " fmt "\n", (s)->filename, (s)->line, ##__VA_ARGS__)
+
+static inline bool __is_blank(char c)
+{
+	return c == ' ' || c == '\t' || c == '\r' || c == '\v' || c == '\f';
+}
 
 /**
- * Process resource acqutision
+ * Get the next token in the current line. Return NULL at the end of the line
+ * or at a comment, which begins with a token starting with '#'.
  */
-static bool __run_current_acquire()
+static inline const char *__next_token(struct script *s, unsigned int *len)
 {
-	struct resource_schedule *rs, *tmp;
+	const char *token;
 
-	list_for_each_entry_safe(rs, tmp, &current->__resources_to_acquire, list) {
-		if (rs->at == current->age) {
-			assert(sched->acquire && "scheduler.acquire() not implemented");
+	while (s->pos < s->end && __is_blank(*s->pos)) s->pos++;
 
-			/* Callback to acquire the resource */
-			if (sched->acquire(rs->resource_id)) {
-				list_move_tail(&rs->list, &current->__resources_holding);
+	if (s->pos == s->end || *s->pos == '\n' || *s->pos == '#') return NULL;
 
-				__print_event(current->pid, "+%d", rs->resource_id);
-			} else {
-				return false;
-			}
-		}
+	token = s->pos;
+	while (s->pos < s->end && !__is_blank(*s->pos) && *s->pos != '\n') {
+		s->pos++;
 	}
-
-	return true;
+	*len = s->pos - token;
+	return token;
 }
 
 /**
- * Process resource release
+ * Skip the rest of the current line including the comment
  */
-static void __run_current_release()
+static inline void __next_line(struct script *s)
 {
-	struct resource_schedule *rs, *tmp;
+	const char *nl = memchr(s->pos, '\n', s->end - s->pos);
 
-	list_for_each_entry_safe(rs, tmp, &current->__resources_holding, list) {
-		if (--rs->duration == 0) {
-			assert(sched->release && "scheduler.release() not implemented");
+	s->pos = nl ? nl + 1 : s->end;
+	s->line++;
+}
 
-			/* Callback the release() */
-			sched->release(rs->resource_id);
+static inline bool __keyword(const char *token, unsigned int len, const char *keyword)
+{
+	return strlen(keyword) == len && memcmp(token, keyword, len) == 0;
+}
+
+/**
+ * Parse the next token as a non-negative decimal integer for @what
+ */
+static bool __parse_uint(struct script *s, const char *what, unsigned int *value)
+{
+	unsigned int len;
+	const char *token = __next_token(s, &len);
+	unsigned long v = 0;
 
-			__print_event(current->pid, "-%d", rs->resource_id);
+	if (!token) {
+		__script_error(s, "Missing %s", what);
+		return false;
+	}
 
-			list_del(&rs->list);
-			free(rs);
+	for (unsigned int i = 0; i < len; i++) {
+		if (token[i] < '0' || token[i] > '9') {
+			__script_error(s, "Invalid %s %.*s", what, len, token);
+			return false;
+		}
+		v = v * 10 + (token[i] - '0');
+		if (v > UINT_MAX) {
+			__script_error(s, "%s %.*s is out of range", what, len, token);
+			return false;
 		}
 	}
+	*value = v;
+	return true;
 }
 
+static bool __expect_eol(struct script *s)
+{
+	unsigned int len;
+	const char *token = __next_token(s, &len);
 
-/***********************************************************************
- * The main loop for the scheduler simulation
+	if (token) {
+		__script_error(s, "Unexpected %.*s", len, token);
+		return false;
+	}
+	return true;
+}
+
+/**
+ * Map the script file into the memory. Fall back to reading it into a buffer
+ * when it cannot be mapped (e.g., a pipe). Set *@mapped accordingly.
  */
-static void __do_simulation(void)
+static char *__map_script(int fd, size_t *size, bool *mapped)
 {
-	assert(sched->schedule && "scheduler.schedule() not implemented");
+	struct stat st;
+	char *buffer = NULL;
+	size_t len = 0, capacity = 0;
+	ssize_t nr;
+
+	if (fstat(fd, &st) == 0 && S_ISREG(st.st_mode)) {
+		*size = st.st_size;
+		*mapped = true;
+		if (st.st_size == 0) return "";
+
+		buffer = mmap(NULL, st.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+		if (buffer != MAP_FAILED) {
+			posix_madvise(buffer, st.st_size, POSIX_MADV_SEQUENTIAL);
+			return buffer;
+		}
+		buffer = NULL;
+	}
 
-	while (true) {
-		struct process *prev;
+	*mapped = false;
+	do {
+		if (len == capacity) {
+			capacity = capacity ? capacity * 2 : 1 << 16;
+			buffer = realloc(buffer, capacity);
+		}
+		nr = read(fd, buffer + len, capacity - len);
+		if (nr > 0) len += nr;
+	} while (nr > 0);
 
-		/* Fork processes on schedule */
-		__fork_on_schedule();
+	if (nr < 0) {
+		free(buffer);
+		return NULL;
+	}
+	*size = len;
+	return buffer;
+}
 
-		/* Ask scheduler to pick the next process to run */
-		prev = current;
-		current = sched->schedule();
+/**
+ * Check @resource_id in the script. The resource table is already in place in
+ * the streaming mode, so the resource should fit in the table.
+ */
+static bool __check_resource(struct script *s, unsigned int resource_id)
+{
+	unsigned int limit = max_resources ? max_resources : MAX_NR_RESOURCES;
 
-		/* If the system ran a process in the previous tick, */
-		if (prev) {
-			/* Update the process status */
-			if (prev->status == PROCESS_RUNNING) {
-				prev->status = PROCESS_READY;
-			}
+	if (resources) limit = nr_resources;
 
-			/* Decommission it if completed */
-			if (prev->age == prev->lifespan) {
-				prev->status = PROCESS_EXIT;
-				__exit_process(prev);
-			}
-		}
-		
-		/* No process is ready to run at this moment */
-		if (!current) {
-			/* Quit simulation if no pending process exists */
-			if (list_empty(&readyqueue) && list_empty(&__forkqueue)) {
-				break;
-			}
+	if (resource_id >= limit) {
+		__script_error(s, "Resource %u is out of range%s", resource_id,
+				resources && !max_resources ? ". Specify # of resources with -n" : "");
+		return false;
+	}
+	if (resource_id >= __workload.nr_resources) {
+		__workload.nr_resources = resource_id + 1;
+	}
+	return true;
+}
 
-			/* Idle temporarily */
-			fprintf(stderr, "%3d: idle\n", ticks);
-			goto next;
-		}
+/**
+ * Declare @wr for the resource table. Return false if declared already
+ */
+static bool __declare_resource(const struct workload_resource *wr)
+{
+	for (unsigned int i = 0; i < __workload.nr_declarations; i++) {
+		if (__workload.declarations[i].resource_id == wr->resource_id) return false;
+	}
 
-		/* Execute the current process */
-		current->status = PROCESS_RUNNING;
-		//printf("currnet process prio : %d\n",current->prio);
-		/* Ensure that @current is detached from any list */
-		assert(list_empty(&current->list));
+	__workload.declarations = realloc(__workload.declarations,
+			sizeof(*wr) * (__workload.nr_declarations + 1));
+	assert(__workload.declarations);
+	__workload.declarations[__workload.nr_declarations++] = *wr;
 
-		/* Try acquiring scheduled resources */
-		if (__run_current_acquire()) {
-			/* Succesfully acquired all the resources to make a progress! */
-			__print_event(current->pid, "%d", current->pid);
+	if (!quiet) __briefing_resource(wr);
+	return true;
+}
 
-			/* So, it ages by one tick */
-			current->age++;
+/**
+ * Parse the resource declarations at the beginning of the script, which are;
+ *
+ *   semaphore [resource id] [capacity]
+ *   rwlock [resource id]
+ */
+static bool __parse_declarations(struct script *s)
+{
+	while (s->pos < s->end) {
+		const char *pos = s->pos;
+		struct workload_resource wr = { 0 };
+		unsigned int len;
+		const char *token = __next_token(s, &len);
+
+		if (!token) {
+			__next_line(s);
+			continue;
+		}
 
-			/* And performs scheduled releases */
-			__run_current_release();
+		if (__keyword(token, len, "semaphore")) {
+			wr.kind = RESOURCE_SEMAPHORE;
+			if (!__parse_uint(s, "resource", &wr.resource_id) ||
+					!__parse_uint(s, "capacity", &wr.capacity)) {
+				return false;
+			}
+			if (!wr.capacity) {
+				__script_error(s, "Semaphore %u has no unit", wr.resource_id);
+				return false;
+			}
+		} else if (__keyword(token, len, "rwlock")) {
+			wr.kind = RESOURCE_RWLOCK;
+			wr.capacity = 1;
+			if (!__parse_uint(s, "resource", &wr.resource_id)) return false;
 		} else {
-			/**
-			 * The current is blocked while acquiring resource(s).
-			 * In this case, @current could not make a progress in this tick
-			 */
-			__print_event(current->pid, "=");
-
-			/* Thus, it is not get aged nor unable to perform releases */
+			/* Process descriptions follow */
+			s->pos = pos;
+			return true;
 		}
 
-next:
-		/* Increase the tick counter */
-		ticks++;
+		if (!__expect_eol(s) || !__check_resource(s, wr.resource_id)) return false;
+		if (!__declare_resource(&wr)) {
+			__script_error(s, "Resource %u is declared again", wr.resource_id);
+			return false;
+		}
 	}
+	return true;
 }
 
-
-static void __initialize(void)
+/**
+ * Parse the next process description in @s into *@pp. *@pp is set to NULL
+ * at the end of the script.
+ */
+static bool __parse_process(struct script *s, struct process **pp)
 {
-	INIT_LIST_HEAD(&readyqueue);
+	struct process *p = NULL;
+	unsigned int process_line = 0;
 
-	for (int i = 0; i < NR_RESOURCES; i++) {
-		resources[i].owner = NULL;
-		INIT_LIST_HEAD(&(resources[i].waitqueue));
-	}
+	while (s->pos < s->end) {
+		unsigned int len;
+		const char *token = __next_token(s, &len);
+
+		if (!token) {
+			__next_line(s);
+			continue;
+		}
+
+		if (!p && !__keyword(token, len, "process")) {
+			__script_error(s, "%.*s outside of process description", len, token);
+			return false;
+		}
+
+		switch (token[0]) {
+		case 'p':
+			if (__keyword(token, len, "process")) {
+				if (p) {
+					__script_error(s, "Process %u is not ended", p->pid);
+					return false;
+				}
+				/* Start processor description */
+				p = __alloc_process();
+				if (!__parse_uint(s, "pid", &p->pid)) return false;
+
+				process_line = s->line;
+				break;
+			} else if (__keyword(token, len, "prio")) {
+				if (!__parse_uint(s, "priority", &p->prio)) return false;
+				if (p->prio >= MAX_PRIO) {
+					__script_error(s, "Priority %u is out of range", p->prio);
+					return false;
+				}
+				p->prio_orig = p->prio;
+				break;
+			}
+			goto unknown;
+		case 'e':
+			if (__keyword(token, len, "end")) {
+				/* End of process description */
+				if (!__expect_eol(s)) return false;
+
+				*pp = p;
+				return true;
+			}
+			goto unknown;
+		case 'l':
+			if (__keyword(token, len, "lifespan")) {
+				if (!__parse_uint(s, "lifespan", &p->lifespan)) return false;
+				break;
+			}
+			goto unknown;
+		case 's':
+			if (__keyword(token, len, "start")) {
+				if (!__parse_uint(s, "start", &p->__starts_at)) return false;
+				break;
+			}
+			goto unknown;
+		case 'a':
+			if (__keyword(token, len, "acquire") ||
+					__keyword(token, len, "acquire_shared")) {
+				struct resource_schedule *rs;
+
+				rs = __alloc_resource_schedule();
+				rs->shared = len > strlen("acquire");
+				if (!__parse_uint(s, "resource", &rs->resource_id) ||
+						!__parse_uint(s, "acquisition time", &rs->at) ||
+						!__parse_uint(s, "duration", &rs->duration)) {
+					return false;
+				}
+				if (!__check_resource(s, rs->resource_id)) return false;
+				list_add_tail(&rs->list, &p->__resources_to_acquire);
+				break;
+			}
+			goto unknown;
+		default:
+unknown:
+			__script_error(s, "Unknown property %.*s", len, token);
+			return false;
+		}
+
+		if (!__expect_eol(s)) return false;
+	}
+
+	if (p) {
+		s->line = process_line;
+		__script_error(s, "Process %u is not ended", p->pid);
+		return false;
+	}
+
+	*pp = NULL;
+	return true;
+}
+
+static bool __parse_script(struct script *s)
+{
+	struct process *p;
+
+	while (__parse_process(s, &p)) {
+		if (!p) return true;
+
+		list_add_tail(&p->list, &__forkqueue);
+		__briefing_process(p);
+	}
+	return false;
+}
+
+/**
+ * Use the precompiled workload @image in place. Only the header is examined
+ * here; the records are checked when they are fetched.
+ */
+static bool __load_workload(const char *filename, char *image, size_t size)
+{
+	const struct workload_header *h = (const void *)image;
+	const struct workload_process *wp = (const void *)(h + 1);
+	const struct workload_resource *wr;
+	size_t nr_bytes = size - sizeof(*h);
+
+	if (h->version != WORKLOAD_VERSION || h->byte_order != WORKLOAD_BYTE_ORDER ||
+			h->nr_processes > nr_bytes / sizeof(*wp) ||
+			h->nr_schedules > (nr_bytes - h->nr_processes * sizeof(*wp)) /
+					sizeof(struct workload_schedule)) {
+		fprintf(stderr, "%s is not a compatible workload image. Compile it again\n",
+				filename);
+		return false;
+	}
+
+	if (h->nr_declarations > (nr_bytes - h->nr_processes * sizeof(*wp) -
+				h->nr_schedules * sizeof(struct workload_schedule)) /
+					sizeof(struct workload_resource)) {
+		fprintf(stderr, "%s is not a compatible workload image. Compile it again\n",
+				filename);
+		return false;
+	}
+
+	if (max_resources && h->nr_resources > max_resources) {
+		fprintf(stderr, "%s uses %u resources, more than specified\n",
+				filename, h->nr_resources);
+		return false;
+	}
+
+	__workload.precompiled = true;
+	__workload.nr_resources = h->nr_resources;
+	__workload.next = wp;
+	__workload.end = wp + h->nr_processes;
+	__workload.schedules = (const void *)__workload.end;
+	__workload.nr_schedules = h->nr_schedules;
+	__workload.schedules_dropped = image +
+			(((const char *)__workload.schedules - image + WORKLOAD_DROP_SIZE - 1) &
+			 ~(size_t)(WORKLOAD_DROP_SIZE - 1));
+
+	wr = (const void *)(__workload.schedules + h->nr_schedules);
+	for (unsigned int i = 0; i < h->nr_declarations; i++) {
+		if (wr[i].resource_id >= h->nr_resources ||
+				(wr[i].kind != RESOURCE_SEMAPHORE && wr[i].kind != RESOURCE_RWLOCK) ||
+				!wr[i].capacity || !__declare_resource(wr + i)) {
+			fprintf(stderr, "Workload image %s is corrupted\n", filename);
+			return false;
+		}
+	}
+	return true;
+}
+
+static void __unload_workload(void)
+{
+	free(__workload.declarations);
+
+	if (__workload.image && !__workload.shared) {
+		if (__workload.mapped) {
+			if (__workload.size) munmap(__workload.image, __workload.size);
+		} else {
+			free(__workload.image);
+		}
+	}
+	memset(&__workload, 0x00, sizeof(__workload));
+}
+
+/**
+ * Drop the mapped pages of the workload below @pos down to *@dropped in the
+ * streaming mode. They have been consumed and will not be accessed again.
+ */
+static void __drop_workload(const char **dropped, const void *pos)
+{
+	const char *end = __workload.image +
+			(((const char *)pos - __workload.image) & ~(size_t)(WORKLOAD_DROP_SIZE - 1));
+
+	if (!streaming || !__workload.mapped || end <= *dropped) return;
+
+	madvise((void *)*dropped, end - *dropped, MADV_DONTNEED);
+	*dropped = end;
+}
+
+static bool __fetch_image(struct process **pp)
+{
+	const struct workload_process *wp = __workload.next;
+	const struct workload_schedule *ws;
+	struct process *p;
+
+	if (wp == __workload.end) {
+		*pp = NULL;
+		return true;
+	}
+
+	if (wp->schedule > __workload.nr_schedules ||
+			wp->nr_schedules > __workload.nr_schedules - wp->schedule ||
+			wp->prio >= MAX_PRIO) {
+		fprintf(stderr, "Workload image %s is corrupted\n", __sim->scriptfile);
+		return false;
+	}
+	ws = __workload.schedules + wp->schedule;
+
+	p = __alloc_process();
+	p->pid = wp->pid;
+	p->__starts_at = wp->starts_at;
+	p->lifespan = wp->lifespan;
+	p->prio = p->prio_orig = wp->prio;
+
+	for (unsigned int i = 0; i < wp->nr_schedules; i++) {
+		struct resource_schedule *rs;
+
+		if (ws[i].resource_id >= nr_resources) {
+			fprintf(stderr, "Workload image %s is corrupted\n", __sim->scriptfile);
+			return false;
+		}
+
+		rs = __alloc_resource_schedule();
+		rs->resource_id = ws[i].resource_id;
+		rs->at = ws[i].at;
+		rs->duration = ws[i].duration;
+		rs->shared = !!(ws[i].flags & WORKLOAD_SCHEDULE_SHARED);
+		list_add_tail(&rs->list, &p->__resources_to_acquire);
+	}
+
+	__workload.next++;
+	__drop_workload(&__workload.dropped, __workload.next);
+	__drop_workload(&__workload.schedules_dropped, ws + wp->nr_schedules);
+
+	*pp = p;
+	return true;
+}
+
+static bool __fetch_script(struct process **pp)
+{
+	struct script *s = &__workload.script;
+
+	if (!__parse_process(s, pp)) return false;
+	if (!*pp) return true;
+
+	if ((*pp)->__starts_at < __workload.last_starts_at) {
+		__script_error(s, "Process %u is not sorted by the start time", (*pp)->pid);
+		return false;
+	}
+	__workload.last_starts_at = (*pp)->__starts_at;
+
+	__drop_workload(&__workload.dropped, s->pos);
+	return true;
+}
+
+/**
+ * Fetch the processes to be forked by @until into the fork queue, and one
+ * more to tell when the next fork is
+ */
+static bool __fetch_workload(unsigned int until)
+{
+	while (__workload.image && !__workload.exhausted) {
+		struct process *p;
+
+		if (!list_empty(&__forkqueue) &&
+				list_last_entry(&__forkqueue, struct process, list)->__starts_at > until) {
+			break;
+		}
+
+		if (!(__workload.precompiled ? __fetch_image(&p) : __fetch_script(&p))) {
+			return false;
+		}
+
+		if (!p) {
+			__workload.exhausted = true;
+			if (!quiet) fprintf(__sim->out, "\n");
+			break;
+		}
+
+		list_add_tail(&p->list, &__forkqueue);
+		__briefing_process(p);
+	}
+	return true;
+}
+
+/**
+ * Set up the resource table for @nr resources as declared in the script
+ */
+static bool __alloc_resources(unsigned int nr)
+{
+	nr_resources = nr;
+
+	resources = calloc(nr ? nr : 1, sizeof(*resources));
+	assert(resources);
+	for (unsigned int i = 0; i < nr; i++) {
+		INIT_LIST_HEAD(&resources[i].waitqueue);
+		resources[i].kind = RESOURCE_MUTEX;
+		resources[i].capacity = 1;
+	}
+
+	__resources_shared = calloc(BITS_TO_LONGS(nr) + 1, sizeof(unsigned long));
+	__resources_active = calloc(BITS_TO_LONGS(nr) + 1, sizeof(unsigned long));
+	__active_resources = malloc(sizeof(*__active_resources) * (nr ? nr : 1));
+	__nr_active_resources = 0;
+	assert(__resources_shared && __resources_active && __active_resources);
+
+	if (__track_blocking()) {
+		__blocked = malloc(sizeof(*__blocked) * (nr ? nr : 1));
+		assert(__blocked);
+		for (unsigned int i = 0; i < nr; i++) {
+			INIT_LIST_HEAD(__blocked + i);
+		}
+	}
+	if (profile_resources) {
+		__resource_profiles = calloc(nr ? nr : 1, sizeof(*__resource_profiles));
+		assert(__resource_profiles);
+	}
+
+	for (unsigned int i = 0; i < __workload.nr_declarations; i++) {
+		struct workload_resource *wr = __workload.declarations + i;
+
+		if (wr->resource_id >= nr) {
+			fprintf(stderr, "Resource %u is out of range\n", wr->resource_id);
+			return false;
+		}
+		resources[wr->resource_id].kind = wr->kind;
+		resources[wr->resource_id].capacity = wr->capacity;
+	}
+	return true;
+}
+
+static void __free_resources(void)
+{
+	free(resources);
+	free(__resources_shared);
+	free(__resources_active);
+	free(__active_resources);
+	free(__blocked);
+	free(__resource_profiles);
+
+	resources = NULL;
+	nr_resources = 0;
+	__resources_shared = __resources_active = NULL;
+	__active_resources = NULL;
+	__blocked = NULL;
+	__resource_profiles = NULL;
+}
+
+static void __raise_ceilings(unsigned int prio, const struct list_head *schedules)
+{
+	struct resource_schedule *rs;
+
+	list_for_each_entry(rs, schedules, list) {
+		struct resource *r = resources + rs->resource_id;
+
+		if (prio > r->ceiling) r->ceiling = prio;
+	}
+}
+
+/**
+ * Set the priority ceilings of the resources from the acquisition schedules.
+ * The processes are not in the memory yet in the streaming mode, so the script
+ * is parsed once more from the beginning, recycling the processes right away.
+ * Corrupted records in the image are skipped here; they are reported when
+ * they are fetched.
+ */
+static bool __set_ceilings(void)
+{
+	struct process *p;
+
+	if (__workload.precompiled) {
+		for (const struct workload_process *wp = __workload.next;
+				wp < __workload.end; wp++) {
+			const struct workload_schedule *ws;
+
+			if (wp->schedule > __workload.nr_schedules ||
+					wp->nr_schedules > __workload.nr_schedules - wp->schedule ||
+					wp->prio >= MAX_PRIO) {
+				continue;
+			}
+			ws = __workload.schedules + wp->schedule;
+
+			for (unsigned int i = 0; i < wp->nr_schedules; i++) {
+				struct resource *r;
+
+				if (ws[i].resource_id >= nr_resources) continue;
+
+				r = resources + ws[i].resource_id;
+				if (wp->prio > r->ceiling) r->ceiling = wp->prio;
+			}
+		}
+	} else if (streaming) {
+		struct script s = __workload.script;
+
+		while (true) {
+			struct resource_schedule *rs, *tmp;
+
+			if (!__parse_process(&s, &p)) return false;
+			if (!p) break;
+
+			__raise_ceilings(p->prio_orig, &p->__resources_to_acquire);
+			list_for_each_entry_safe(rs, tmp, &p->__resources_to_acquire, list) {
+				__free_resource_schedule(rs);
+			}
+			__free_process(p);
+		}
+	} else {
+		list_for_each_entry(p, &__forkqueue, list) {
+			__raise_ceilings(p->prio_orig, &p->__resources_to_acquire);
+		}
+	}
+	return true;
+}
+
+/**
+ * Load the script or the workload image @filename. When @resuming from a
+ * checkpoint, the processes in the script are not parsed here, and the
+ * resources are not set up as they are restored from the checkpoint.
+ * The image given in the simulation is used in place of @filename if any.
+ */
+static int __load_script(char * const filename, bool resuming)
+{
+	struct script s = {
+		.filename = filename,
+		.line = 1,
+	};
+	bool mapped;
+	size_t size;
+	char *buffer;
+	int ret;
+
+	if (__sim->image) {
+		buffer = __sim->image;
+		size = __sim->image_size;
+		mapped = false;
+	} else {
+		int fd = open(filename, O_RDONLY);
+		if (fd < 0) {
+			fprintf(stderr, "Unable to open %s\n", filename);
+			return false;
+		}
+
+		buffer = __map_script(fd, &size, &mapped);
+		close(fd);
+		if (!buffer) {
+			fprintf(stderr, "Unable to read %s\n", filename);
+			return false;
+		}
+	}
+
+	s.pos = buffer;
+	s.end = buffer + size;
+
+	if (size >= sizeof(struct workload_header) &&
+			memcmp(buffer, WORKLOAD_MAGIC, sizeof(WORKLOAD_MAGIC)) == 0) {
+		ret = __load_workload(filename, buffer, size);
+	} else if (!__parse_declarations(&s)) {
+		ret = false;
+	} else if (streaming || resuming) {
+		__workload.script = s;
+		ret = true;
+	} else {
+		ret = __parse_script(&s);
+		if (ret && !quiet) fprintf(__sim->out, "\n");
+		__sort_forkqueue();
+	}
+
+	/**
+	 * Resources are used as they are listed in the streaming mode, so the
+	 * table should be ready now, having NR_RESOURCES by default
+	 */
+	if (ret && !resuming) {
+		unsigned int nr = __workload.nr_resources;
+
+		if (nr < NR_RESOURCES) nr = NR_RESOURCES;
+		ret = __alloc_resources(max_resources ? max_resources : nr) && __set_ceilings();
+	}
+
+	/* The workload is used in place until the simulation is over */
+	if (ret && (__workload.precompiled || streaming)) {
+		__workload.image = buffer;
+		__workload.size = size;
+		__workload.mapped = mapped;
+		__workload.shared = buffer == __sim->image;
+		__workload.dropped = buffer;
+	} else if (buffer == __sim->image) {
+		/* Leave the shared image to the owner */
+	} else if (!mapped) {
+		free(buffer);
+	} else if (size) {
+		munmap(buffer, size);
+	}
+
+	return ret;
+}
+
+
+/**
+ * Sort the acquisition schedules of @p by the acquisition time so that only
+ * the first one needs to be examined on each tick. The sort is stable to keep
+ * acquiring resources at the same age in the scripted order. Schedules are
+ * usually scripted in order, so the insertion sort takes a linear time.
+ */
+static void __sort_acquisitions(struct process *p)
+{
+	struct list_head *head = &p->__resources_to_acquire;
+	struct resource_schedule *rs, *tmp;
+
+	list_for_each_entry_safe(rs, tmp, head, list) {
+		struct resource_schedule *pos = list_prev_entry(rs, list);
+
+		while (&pos->list != head && pos->at > rs->at) {
+			pos = list_prev_entry(pos, list);
+		}
+		if (pos != list_prev_entry(rs, list)) list_move(&rs->list, &pos->list);
+	}
+}
+
+/**
+ * Fork process on schedule. The fork queue is sorted by the fork time,
+ * so only the processes at the head of the queue need to be examined.
+ */
+static void __switch_cpu(unsigned int cpu);
+
+/**
+ * Start and stop entitling @p to the share of its CPU as @p becomes runnable
+ * and unrunnable. Processes become runnable when forked and woken up, and
+ * unrunnable when blocked and exited.
+ */
+static inline bool __track_shares(void)
+{
+	return show_metrics && sched->tickets;
+}
+
+static void __advance_vclock(struct cpu *cpu)
+{
+	if (cpu->nr_tickets) {
+		cpu->vclock += (double)(ticks - cpu->vclock_at) / cpu->nr_tickets;
+	}
+	cpu->vclock_at = ticks;
+}
+
+static void __share_start(struct process *p)
+{
+	struct cpu *cpu = cpus + p->cpu;
+
+	__advance_vclock(cpu);
+	cpu->nr_tickets += sched->tickets(p);
+	p->__vclock_at = cpu->vclock;
+}
+
+static void __share_stop(struct process *p)
+{
+	struct cpu *cpu = cpus + p->cpu;
+	unsigned int tickets = sched->tickets(p);
+
+	__advance_vclock(cpu);
+	p->__entitled += tickets * (cpu->vclock - p->__vclock_at);
+	cpu->nr_tickets -= tickets;
+}
+
+static int __fork_on_schedule()
+{
+	int nr_forked = 0;
+
+	if (!__fetch_workload(ticks)) return -1;
+
+	while (!list_empty(&__forkqueue)) {
+		struct process *p =
+				list_first_entry(&__forkqueue, struct process, list);
+
+		if (p->__starts_at > ticks) break;
+
+		/* Spread new processes over the CPUs in the round-robin way */
+		p->cpu = __nr_forked++ % nr_cpus;
+		__switch_cpu(p->cpu);
+
+		__sort_acquisitions(p);
+
+		list_move_tail(&p->list, &readyqueue);
+		list_add_tail(&p->__live, &__live_processes);
+		p->status = PROCESS_READY;
+		__print_event(TRACE_FORK, p->pid, 0);
+		if (sched->forked) sched->forked(p);
+		if (__track_shares()) __share_start(p);
+		nr_forked++;
+	}
+	return nr_forked;
+}
+
+/**
+ * Exit the process
+ */
+static void __exit_process(struct process *p)
+{
+	/* Make sure the process is not attached to some list head */
+	assert(list_empty(&p->list));
+
+	/* Make sure the process is not holding any resource */
+	assert(list_empty(&p->__resources_holding));
+
+	/* Make sure there is no pending resource to acquire */
+	assert(list_empty(&p->__resources_to_acquire));
+
+	if (sched->exiting) sched->exiting(p);
+
+	__print_event(TRACE_EXIT, p->pid, 0);
+	list_del_init(&p->__live);
+
+	if (show_metrics) {
+		if (__track_shares()) __share_stop(p);
+
+		if (__nr_metrics == __max_metrics) {
+			__max_metrics = __max_metrics ? __max_metrics * 2 : 1024;
+			__metrics = realloc(__metrics, sizeof(*__metrics) * __max_metrics);
+			assert(__metrics);
+		}
+		__metrics[__nr_metrics++] = (struct metrics) {
+			.pid = p->pid,
+			.arrival = p->__starts_at,
+			.first_run = p->__first_run_at,
+			.completion = ticks,
+			.lifespan = p->lifespan,
+			.nr_blocked = p->__nr_blocked,
+			.nr_switches = p->__nr_switches,
+			.tickets = sched->tickets ? sched->tickets(p) : 0,
+			.entitled = p->__entitled,
+		};
+	}
+
+	__free_process(p);
+}
+
+
+static void __update_waiters(struct resource_profile *rp, int delta)
+{
+	rp->waiters_ticks += (unsigned long long)rp->nr_waiters * (ticks - rp->waiters_since);
+	rp->waiters_since = ticks;
+	rp->nr_waiters += delta;
+	if (rp->nr_waiters > rp->max_waiters) rp->max_waiters = rp->nr_waiters;
+}
+
+/**
+ * Keep the longest NR_TOP_INVERSIONS inversions in __inversions[]
+ */
+static void __record_inversion(struct inversion *in)
+{
+	unsigned int i;
+
+	__nr_total_inversions++;
+	__inversion_ticks += in->duration;
+
+	if (__nr_inversions == NR_TOP_INVERSIONS &&
+			in->duration <= __inversions[NR_TOP_INVERSIONS - 1].duration) {
+		return;
+	}
+	if (__nr_inversions < NR_TOP_INVERSIONS) __nr_inversions++;
+
+	for (i = __nr_inversions - 1; i > 0 && __inversions[i - 1].duration < in->duration; i--) {
+		__inversions[i] = __inversions[i - 1];
+	}
+	__inversions[i] = *in;
+}
+
+/**
+ * @current got blocked for @resource_id
+ */
+static void __account_block(unsigned int resource_id)
+{
+	struct resource_profile *rp = __resource_profiles + resource_id;
+	struct process *owner = resources[resource_id].owner;
+
+	current->__blocked_at = ticks;
+	list_add_tail(&current->__blocked, __blocked + resource_id);
+
+	if (__track_shares()) __share_stop(current);
+
+	if (!profile_resources) return;
+
+	rp->nr_contended++;
+	__update_waiters(rp, +1);
+
+	current->__inverted = owner && owner->prio_orig < current->prio_orig;
+	if (current->__inverted) {
+		current->__owner_pid = owner->pid;
+		current->__owner_prio = owner->prio_orig;
+	}
+}
+
+/**
+ * Put @rs into the resources @current is holding, which are kept sorted by
+ * the release time. Resources to release at the same age are released in the
+ * order they were acquired.
+ */
+static void __hold_resource(struct resource_schedule *rs)
+{
+	struct list_head *head = &current->__resources_holding;
+	struct resource_schedule *pos;
+
+	rs->release_at = current->age + rs->duration;
+
+	list_for_each_entry_reverse(pos, head, list) {
+		if (pos->release_at <= rs->release_at) break;
+	}
+	list_move(&rs->list, &pos->list);
+}
+
+/**
+ * Process resource acqutision. Schedules are sorted by the acquisition time,
+ * so the ones to acquire at this age are at the head.
+ */
+static bool __run_current_acquire()
+{
+	struct resource_schedule *rs, *tmp;
+
+	list_for_each_entry_safe(rs, tmp, &current->__resources_to_acquire, list) {
+		struct resource *r = resources + rs->resource_id;
+		bool shared = rs->shared && r->kind == RESOURCE_RWLOCK;
+
+		if (rs->at != current->age) break;
+
+		assert(sched->acquire && "scheduler.acquire() not implemented");
+		assert((!shared || sched->acquire_shared) &&
+				"scheduler.acquire_shared() not implemented");
+
+		__activate_resource(rs->resource_id);
+
+		/* Callback to acquire the resource */
+		if (shared ? sched->acquire_shared(rs->resource_id) : sched->acquire(rs->resource_id)) {
+			if (r->kind == RESOURCE_SEMAPHORE) {
+				assert(r->nr_holders < r->capacity && "Semaphore is granted over its capacity");
+			} else if (shared) {
+				assert((!r->nr_holders || __test_bit(__resources_shared, rs->resource_id)) &&
+						"Resource is granted while being held exclusively");
+				__set_bit(__resources_shared, rs->resource_id);
+			} else {
+				assert(!r->nr_holders && "Resource is granted twice");
+			}
+			r->nr_holders++;
+
+			__hold_resource(rs);
+
+			__print_event(TRACE_ACQUIRE, current->pid, rs->resource_id);
+
+			if (profile_resources) {
+				rs->acquired_at = ticks;
+				__resource_profiles[rs->resource_id].nr_acquisitions++;
+			}
+		} else {
+			if (__track_blocking()) __account_block(rs->resource_id);
+			return false;
+		}
+	}
+
+	return true;
+}
+
+/**
+ * Account the blocked ticks of the processes woken up by releasing
+ * @resource_id. They can run from the next tick.
+ */
+static void __account_wakeups(unsigned int resource_id)
+{
+	struct resource_profile *rp = __resource_profiles + resource_id;
+	struct process *p, *tmp;
+
+	list_for_each_entry_safe(p, tmp, __blocked + resource_id, __blocked) {
+		unsigned int nr;
+
+		if (p->status == PROCESS_WAIT) continue;
+
+		nr = ticks + 1 - p->__blocked_at;
+		p->__nr_blocked += nr;
+		list_del_init(&p->__blocked);
+
+		if (__track_shares()) __share_start(p);
+
+		if (!profile_resources) continue;
+
+		__update_waiters(rp, -1);
+		rp->wait_ticks += nr;
+		if (nr > rp->max_wait) rp->max_wait = nr;
+
+		if (p->__inverted) {
+			struct inversion in = {
+				.resource_id = resource_id,
+				.pid = p->pid,
+				.prio = p->prio_orig,
+				.owner_pid = p->__owner_pid,
+				.owner_prio = p->__owner_prio,
+				.since = p->__blocked_at,
+				.duration = nr,
+			};
+			__record_inversion(&in);
+		}
+	}
+}
+
+/**
+ * Process resource release. Resources to release at this age are at the head
+ */
+static void __run_current_release()
+{
+	struct resource_schedule *rs, *tmp;
+
+	list_for_each_entry_safe(rs, tmp, &current->__resources_holding, list) {
+		struct resource *r = resources + rs->resource_id;
+		bool shared = rs->shared && r->kind == RESOURCE_RWLOCK;
+
+		if (rs->release_at != current->age) break;
+
+		assert(sched->release && "scheduler.release() not implemented");
+		assert((!shared || sched->release_shared) &&
+				"scheduler.release_shared() not implemented");
+		assert(r->nr_holders && "Resource is released without being granted");
+
+		if (--r->nr_holders == 0) __clear_bit(__resources_shared, rs->resource_id);
+
+		/* Callback the release() */
+		if (shared) {
+			sched->release_shared(rs->resource_id);
+		} else {
+			sched->release(rs->resource_id);
+		}
+
+		if (profile_resources) {
+			__resource_profiles[rs->resource_id].hold_ticks +=
+					ticks + 1 - rs->acquired_at;
+		}
+		if (__track_blocking()) __account_wakeups(rs->resource_id);
+
+		__print_event(TRACE_RELEASE, current->pid, rs->resource_id);
+
+		list_del(&rs->list);
+		__free_resource_schedule(rs);
+	}
+}
+
+
+/**
+ * The tick when the next process in the fork queue is forked.
+ * UINT_MAX if no process is pending to be forked.
+ */
+static unsigned int __next_fork_at(void)
+{
+	if (list_empty(&__forkqueue)) return UINT_MAX;
+
+	return list_first_entry(&__forkqueue, struct process, list)->__starts_at;
+}
+
+/**
+ * Count the ticks following the current tick on which nothing would happen
+ * but @current keeps running (or the processor keeps idling if there is no
+ * @current). Those ticks end at the next fork, acquisition, release, or exit.
+ */
+static unsigned int __nr_uneventful_ticks(void)
+{
+	unsigned int next_fork = __next_fork_at();
+	unsigned int nr = next_fork == UINT_MAX ? UINT_MAX : next_fork - ticks - 1;
+	struct resource_schedule *rs;
+
+	if (!current) {
+		return list_empty(&readyqueue) ? nr : 0;
+	}
+
+	if (current->status != PROCESS_RUNNING || cpus[this_cpu].switching) return 0;
+
+	switch (sched->tickless) {
+	case TICKLESS_ALWAYS:
+		break;
+	case TICKLESS_ALONE:
+		if (list_empty(&readyqueue) && !(sched->nr_ready && sched->nr_ready())) {
+			break;
+		}
+		/* Fall through */
+	default:
+		return 0;
+	}
+
+	if (nr > current->lifespan - current->age) {
+		nr = current->lifespan - current->age;
+	}
+
+	/* Only the first schedules matter as they are sorted by the time */
+	if (!list_empty(&current->__resources_to_acquire)) {
+		rs = list_first_entry(&current->__resources_to_acquire,
+				struct resource_schedule, list);
+		if (rs->at >= current->age && nr > rs->at - current->age) {
+			nr = rs->at - current->age;
+		}
+	}
+
+	if (!list_empty(&current->__resources_holding)) {
+		rs = list_first_entry(&current->__resources_holding,
+				struct resource_schedule, list);
+		if (nr > rs->release_at - current->age - 1) {
+			nr = rs->release_at - current->age - 1;
+		}
+	}
+
+	return nr;
+}
+
+/**
+ * Advance the simulation by @nr uneventful ticks at once
+ */
+static void __fast_forward(unsigned int nr)
+{
+	if (compress_trace && nr > 1) {
+		ticks++;
+		__print_event(current ? TRACE_RUN : TRACE_IDLE,
+				current ? current->pid : 0, nr);
+		ticks += nr - 1;
+	} else {
+		for (unsigned int i = 0; i < nr; i++) {
+			ticks++;
+			__print_event(current ? TRACE_RUN : TRACE_IDLE,
+					current ? current->pid : 0, 1);
+		}
+	}
+
+	if (!current) {
+		cpus[this_cpu].nr_idle += nr;
+		return;
+	}
+
+	current->age += nr;
+}
+
+
+/**
+ * Switch the simulation context to @cpu. @current and @readyqueue of the
+ * previous CPU are parked in @cpus[], and those of @cpu are brought back.
+ */
+static void __switch_cpu(unsigned int cpu)
+{
+	if (cpu == this_cpu) return;
+
+	cpus[this_cpu].current = current;
+	list_splice_init(&readyqueue, &cpus[this_cpu].readyqueue);
+
+	current = cpus[cpu].current;
+	list_splice_init(&cpus[cpu].readyqueue, &readyqueue);
+
+	this_cpu = cpu;
+}
+
+struct list_head *cpu_readyqueue(unsigned int cpu)
+{
+	assert(cpu < nr_cpus);
+
+	return cpu == this_cpu ? &readyqueue : &cpus[cpu].readyqueue;
+}
+
+/**
+ * True if no CPU has a process to run or ready to run
+ */
+static bool __all_cpus_idle(void)
+{
+	for (unsigned int i = 0; i < nr_cpus; i++) {
+		__switch_cpu(i);
+		if (current || !list_empty(&readyqueue)) return false;
+		if (sched->nr_ready && sched->nr_ready()) return false;
+	}
+	return true;
+}
+
+/**
+ * Ask scheduler to pick the next process to run on this CPU
+ */
+static void __schedule_this_cpu(void)
+{
+	struct process *prev;
+
+	/* Give the scheduler a chance to balance the load among CPUs */
+	if (nr_cpus > 1 && sched->balance) {
+		sched->balance();
+	}
+
+	/**
+	 * @current got blocked on the previous tick, and another CPU has woken
+	 * it up in the meantime. It is in a ready queue (or even has been taken
+	 * by another CPU) now, so it is not the current of this CPU anymore.
+	 */
+	if (current && (current->status == PROCESS_READY || current->cpu != this_cpu)) {
+		current = NULL;
+	}
+
+	prev = current;
+	if (show_stats) {
+		unsigned long long start = __now_ns();
+
+		current = sched->schedule();
+
+		__stats.schedule_ns += __now_ns() - start;
+		__stats.nr_schedules++;
+	} else {
+		current = sched->schedule();
+	}
+
+	/* If the CPU ran a process in the previous tick, */
+	if (prev) {
+		/* Update the process status */
+		if (prev->status == PROCESS_RUNNING) {
+			prev->status = PROCESS_READY;
+		}
+
+		/* Decommission it if completed */
+		if (prev->age == prev->lifespan) {
+			prev->status = PROCESS_EXIT;
+			__exit_process(prev);
+		}
+	}
+
+	/**
+	 * Mark the new current as running right away so that other CPUs do not
+	 * take it as a ready process during this tick.
+	 */
+	if (current) {
+		current->status = PROCESS_RUNNING;
+
+		if (current != prev) {
+			cpus[this_cpu].switching = switch_cost;
+			if (current->__ran_on != UINT_MAX && current->__ran_on != this_cpu) {
+				cpus[this_cpu].switching += migrate_switch_cost;
+			}
+		}
+
+		if (show_metrics && current != prev) {
+			if (current->__first_run_at == UINT_MAX) current->__first_run_at = ticks;
+			current->__nr_switches++;
+		}
+	}
+}
+
+/**
+ * Run @current on this CPU for one tick
+ */
+static void __run_this_cpu(void)
+{
+	/* No process is ready to run at this moment. Idle temporarily */
+	if (!current) {
+		__print_event(TRACE_IDLE, 0, 1);
+		cpus[this_cpu].nr_idle++;
+		return;
+	}
+
+	/* Ensure that @current is detached from any list */
+	assert(list_empty(&current->list));
+
+	/* The CPU is busy switching to @current */
+	if (cpus[this_cpu].switching) {
+		__print_event(TRACE_SWITCH, current->pid, 1);
+		cpus[this_cpu].switching--;
+		cpus[this_cpu].nr_switching++;
+		return;
+	}
+	current->__ran_on = this_cpu;
+
+	/* Try acquiring scheduled resources */
+	if (__run_current_acquire()) {
+		/* Succesfully acquired all the resources to make a progress! */
+		__print_event(TRACE_RUN, current->pid, 1);
+
+		/* So, it ages by one tick */
+		current->age++;
+
+		/* And performs scheduled releases */
+		__run_current_release();
+	} else {
+		/**
+		 * The current is blocked while acquiring resource(s).
+		 * In this case, @current could not make a progress in this tick
+		 */
+		__print_event(TRACE_BLOCK, current->pid, 0);
+
+		/* Thus, it is not get aged nor unable to perform releases */
+	}
+}
+
+
+/***********************************************************************
+ * Checkpoints
+ *
+ * The state of the framework is saved and restored by the same functions
+ * as the checkpoint helpers work in both ways. A checkpoint is taken at the
+ * beginning of a tick before the processes of the tick are forked, with
+ * @this_cpu at CPU 0, and the simulation is resumed from there.
+ ***********************************************************************/
+static uint32_t __checkpoint_flags(void)
+{
+	return (streaming ? CHECKPOINT_STREAMING : 0) |
+			(show_metrics ? CHECKPOINT_METRICS : 0) |
+			(profile_resources ? CHECKPOINT_PROFILE : 0) |
+			(__workload.precompiled ? CHECKPOINT_PRECOMPILED : 0);
+}
+
+/**
+ * The first tick to write a checkpoint at since @from
+ */
+static unsigned int __next_checkpoint(unsigned int from)
+{
+	unsigned int next = UINT_MAX;
+
+	if (!checkpoint_file) return UINT_MAX;
+
+	if (checkpoint_at >= from) next = checkpoint_at;
+	if (checkpoint_every) {
+		unsigned long long at = ((unsigned long long)from + checkpoint_every - 1) /
+				checkpoint_every * checkpoint_every;
+
+		if (!at) at = checkpoint_every;
+		if (at < next) next = at;
+	}
+	return next;
+}
+
+static void __serialize_schedule(struct checkpoint *ck, struct resource_schedule *rs)
+{
+	checkpoint_value(ck, rs->resource_id);
+	checkpoint_value(ck, rs->at);
+	checkpoint_value(ck, rs->duration);
+	checkpoint_value(ck, rs->acquired_at);
+	checkpoint_value(ck, rs->release_at);
+	checkpoint_value(ck, rs->shared);
+
+	if (rs->resource_id >= nr_resources) ck->failed = true;
+}
+
+static void __serialize_schedules(struct checkpoint *ck, struct list_head *head)
+{
+	struct resource_schedule *rs;
+	uint64_t nr = 0;
+
+	if (!ck->restoring) {
+		list_for_each_entry(rs, head, list) nr++;
+	}
+	checkpoint_value(ck, nr);
+
+	if (!ck->restoring) {
+		list_for_each_entry(rs, head, list) {
+			__serialize_schedule(ck, rs);
+		}
+		return;
+	}
+
+	for (uint64_t i = 0; i < nr && !ck->failed; i++) {
+		rs = __alloc_resource_schedule();
+		__serialize_schedule(ck, rs);
+		list_add_tail(&rs->list, head);
+	}
+}
+
+/**
+ * The fields of @p. The list heads are linked by the owners of the lists
+ */
+static void __serialize_process(struct checkpoint *ck, struct process *p)
+{
+	uint64_t blocked_on = p->blocked_on ? p->blocked_on - resources + 1 : 0;
+
+	checkpoint_value(ck, p->pid);
+	checkpoint_value(ck, p->status);
+	checkpoint_value(ck, p->age);
+	checkpoint_value(ck, p->lifespan);
+	checkpoint_value(ck, p->prio);
+	checkpoint_value(ck, p->cpu);
+	checkpoint_value(ck, p->prio_orig);
+	checkpoint_value(ck, p->slice_at);
+	checkpoint_value(ck, p->boosted_at);
+	checkpoint_value(ck, p->pass);
+	checkpoint_value(ck, p->vruntime);
+	checkpoint_value(ck, p->rq_prio);
+	checkpoint_value(ck, p->rq_seq);
+	checkpoint_value(ck, blocked_on);
+	checkpoint_value(ck, p->blocked_shared);
+
+	checkpoint_value(ck, p->__starts_at);
+	checkpoint_value(ck, p->__first_run_at);
+	checkpoint_value(ck, p->__blocked_at);
+	checkpoint_value(ck, p->__nr_blocked);
+	checkpoint_value(ck, p->__nr_switches);
+	checkpoint_value(ck, p->__ran_on);
+	checkpoint_value(ck, p->__entitled);
+	checkpoint_value(ck, p->__vclock_at);
+	checkpoint_value(ck, p->__inverted);
+	checkpoint_value(ck, p->__owner_pid);
+	checkpoint_value(ck, p->__owner_prio);
+
+	if (ck->restoring) {
+		if (p->status > PROCESS_EXIT || p->cpu >= nr_cpus ||
+				p->prio >= MAX_PRIO || p->prio_orig >= MAX_PRIO ||
+				p->rq_prio >= MAX_PRIO || blocked_on > nr_resources) {
+			ck->failed = true;
+		}
+		p->blocked_on = blocked_on && !ck->failed ? resources + blocked_on - 1 : NULL;
+	}
+
+	__serialize_schedules(ck, &p->__resources_to_acquire);
+	__serialize_schedules(ck, &p->__resources_holding);
+}
+
+/**
+ * Processes; the live ones in the fork order, and then the ones to fork
+ */
+static void __serialize_processes(struct checkpoint *ck)
+{
+	struct process *p;
+	uint64_t nr_live = 0, nr_pending = 0;
+
+	if (!ck->restoring) {
+		list_for_each_entry(p, &__live_processes, __live) {
+			p->__checkpoint_id = nr_live++;
+		}
+		list_for_each_entry(p, &__forkqueue, list) {
+			p->__checkpoint_id = nr_live + nr_pending++;
+		}
+	}
+	checkpoint_value(ck, nr_live);
+	checkpoint_value(ck, nr_pending);
+
+	if (!ck->restoring) {
+		list_for_each_entry(p, &__live_processes, __live) {
+			__serialize_process(ck, p);
+		}
+		list_for_each_entry(p, &__forkqueue, list) {
+			__serialize_process(ck, p);
+		}
+		return;
+	}
+
+	if (ck->failed || nr_live + nr_pending > UINT_MAX) {
+		ck->failed = true;
+		return;
+	}
+	ck->nr_processes = nr_live + nr_pending;
+	ck->processes = malloc(sizeof(*ck->processes) * (ck->nr_processes ? ck->nr_processes : 1));
+	assert(ck->processes);
+
+	for (unsigned long i = 0; i < ck->nr_processes; i++) {
+		p = ck->processes[i] = __alloc_process();
+		if (i < nr_live) list_add_tail(&p->__live, &__live_processes);
+
+		__serialize_process(ck, p);
+	}
+}
+
+static void __serialize_resource(struct checkpoint *ck, struct resource *r)
+{
+	checkpoint_value(ck, r->kind);
+	checkpoint_value(ck, r->capacity);
+	checkpoint_value(ck, r->ceiling);
+}
+
+/**
+ * The resource table. Resources are mutexes without a ceiling unless they
+ * are declared or acquired in the script, so only the others are listed
+ */
+static void __serialize_resource_table(struct checkpoint *ck)
+{
+	uint32_t nr = nr_resources, id;
+
+	checkpoint_value(ck, nr);
+	if (ck->restoring) {
+		if (ck->failed || nr > MAX_NR_RESOURCES || !__alloc_resources(nr)) {
+			ck->failed = true;
+			return;
+		}
+	}
+
+	/* Terminated by UINT32_MAX */
+	if (!ck->restoring) {
+		for (id = 0; id < nr_resources; id++) {
+			struct resource *r = resources + id;
+
+			if (r->kind == RESOURCE_MUTEX && !r->ceiling) continue;
+
+			checkpoint_value(ck, id);
+			__serialize_resource(ck, r);
+		}
+		id = UINT32_MAX;
+		checkpoint_value(ck, id);
+		return;
+	}
+
+	for (checkpoint_value(ck, id); id < nr_resources && !ck->failed;
+			checkpoint_value(ck, id)) {
+		__serialize_resource(ck, resources + id);
+	}
+	if (id != UINT32_MAX) ck->failed = true;
+}
+
+/**
+ * The resources that have been activated. The others have not been touched
+ */
+static void __serialize_resources(struct checkpoint *ck)
+{
+	unsigned int nr_active = __nr_active_resources;
+
+	checkpoint_value(ck, nr_active);
+	if (ck->restoring && nr_active > nr_resources) ck->failed = true;
+
+	for (unsigned int i = 0; i < nr_active && !ck->failed; i++) {
+		unsigned int id = ck->restoring ? 0 : __active_resources[i];
+		struct resource *r;
+		bool shared;
+
+		checkpoint_value(ck, id);
+		if (ck->restoring) {
+			if (id >= nr_resources || __test_bit(__resources_active, id)) {
+				ck->failed = true;
+				break;
+			}
+			__activate_resource(id);
+		}
+		r = resources + id;
+
+		shared = __test_bit(__resources_shared, id);
+		checkpoint_value(ck, shared);
+		if (shared) __set_bit(__resources_shared, id);
+
+		checkpoint_process(ck, &r->owner);
+		checkpoint_value(ck, r->nr_holders);
+		checkpoint_list(ck, &r->waitqueue, list);
+
+		if (__track_blocking()) checkpoint_list(ck, __blocked + id, __blocked);
+		if (profile_resources) checkpoint_value(ck, __resource_profiles[id]);
+	}
+}
+
+static void __serialize_metrics(struct checkpoint *ck)
+{
+	uint64_t nr = __nr_metrics;
+
+	checkpoint_value(ck, nr);
+	if (ck->restoring) {
+		if (ck->failed || nr > UINT_MAX) {
+			ck->failed = true;
+			return;
+		}
+		__nr_metrics = nr;
+		for (__max_metrics = 1024; __max_metrics < __nr_metrics; __max_metrics *= 2);
+		__metrics = malloc(sizeof(*__metrics) * __max_metrics);
+		assert(__metrics);
+	}
+	checkpoint_data(ck, __metrics, sizeof(*__metrics) * __nr_metrics);
+}
+
+/**
+ * Where to fetch the processes from next
+ */
+static void __serialize_workload(struct checkpoint *ck)
+{
+	uint64_t pos = 0;
+
+	checkpoint_value(ck, __workload.exhausted);
+
+	if (__workload.precompiled) {
+		const struct workload_process *first = (const void *)
+				((const struct workload_header *)__workload.image + 1);
+
+		if (!ck->restoring) pos = __workload.next - first;
+		checkpoint_value(ck, pos);
+		if (ck->restoring) {
+			if (pos > (uint64_t)(__workload.end - first)) ck->failed = true;
+			else __workload.next = first + pos;
+		}
+	} else if (streaming) {
+		if (!ck->restoring) pos = __workload.script.pos - __workload.image;
+		checkpoint_value(ck, pos);
+		checkpoint_value(ck, __workload.script.line);
+		checkpoint_value(ck, __workload.last_starts_at);
+		if (ck->restoring) {
+			if (pos > __workload.size) ck->failed = true;
+			else __workload.script.pos = __workload.image + pos;
+		}
+	}
+}
+
+static void __serialize(struct checkpoint *ck)
+{
+	__serialize_resource_table(ck);
+	__serialize_processes(ck);
+	if (ck->failed) return;
+
+	checkpoint_list(ck, &__forkqueue, list);
+	checkpoint_value(ck, __nr_forked);
+
+	for (unsigned int i = 0; i < nr_cpus; i++) {
+		struct cpu *cpu = cpus + i;
+
+		checkpoint_process(ck, i == this_cpu ? &current : &cpu->current);
+		checkpoint_list(ck, cpu_readyqueue(i), list);
+		checkpoint_value(ck, cpu->nr_idle);
+		checkpoint_value(ck, cpu->switching);
+		checkpoint_value(ck, cpu->nr_switching);
+		checkpoint_value(ck, cpu->vclock);
+		checkpoint_value(ck, cpu->nr_tickets);
+		checkpoint_value(ck, cpu->vclock_at);
+	}
+
+	__serialize_resources(ck);
+
+	if (show_metrics) __serialize_metrics(ck);
+	if (profile_resources) {
+		checkpoint_value(ck, __nr_inversions);
+		checkpoint_value(ck, __nr_total_inversions);
+		checkpoint_value(ck, __inversion_ticks);
+		checkpoint_value(ck, __inversions);
+		if (__nr_inversions > NR_TOP_INVERSIONS) ck->failed = true;
+	}
+
+	__serialize_workload(ck);
+}
+
+static uint64_t __script_size(const char *filename)
+{
+	struct stat st;
+
+	return stat(filename, &st) ? UINT64_MAX : (uint64_t)st.st_size;
+}
+
+/**
+ * Write the checkpoint of this moment into @checkpoint_file
+ */
+static bool __save_checkpoint(void)
+{
+	struct checkpoint ck;
+	struct checkpoint_header h = {
+		.magic = CHECKPOINT_MAGIC,
+		.version = CHECKPOINT_VERSION,
+		.byte_order = CHECKPOINT_BYTE_ORDER,
+		.script_size = __script_size(__sim->scriptfile),
+		.ticks = ticks,
+		.nr_cpus = nr_cpus,
+		.flags = __checkpoint_flags(),
+	};
+
+	strncpy(h.scheduler, sched->name, sizeof(h.scheduler) - 1);
+
+	if (!checkpoint_open(&ck, checkpoint_file, false)) {
+		fprintf(stderr, "Unable to open %s\n", checkpoint_file);
+		return false;
+	}
+
+	__switch_cpu(0);
+
+	checkpoint_value(&ck, h);
+	__serialize(&ck);
+	if (sched->serialize) sched->serialize(&ck);
+
+	if (!checkpoint_close(&ck, checkpoint_file)) {
+		fprintf(stderr, "Unable to write the checkpoint into %s\n", checkpoint_file);
+		return false;
+	}
+	return true;
+}
+
+/**
+ * Load @filename and restore the simulation from @resume_file in place of
+ * loading the script and initializing the scheduler. *@initialized is set
+ * once the scheduler is initialized, even if the rest fails.
+ */
+static bool __resume(char * const filename, bool *initialized)
+{
+	struct checkpoint ck;
+	struct checkpoint_header h;
+
+	if (!checkpoint_open(&ck, resume_file, true)) {
+		fprintf(stderr, "Unable to open %s\n", resume_file);
+		return false;
+	}
+
+	checkpoint_value(&ck, h);
+	h.scheduler[sizeof(h.scheduler) - 1] = '\0';
+
+	if (ck.failed || memcmp(h.magic, CHECKPOINT_MAGIC, sizeof(CHECKPOINT_MAGIC)) ||
+			h.version != CHECKPOINT_VERSION || h.byte_order != CHECKPOINT_BYTE_ORDER) {
+		fprintf(stderr, "%s is not a compatible checkpoint\n", resume_file);
+		goto fail;
+	}
+	if (strcmp(h.scheduler, sched->name)) {
+		fprintf(stderr, "%s is a checkpoint of %s scheduler\n", resume_file, h.scheduler);
+		goto fail;
+	}
+	if (h.nr_cpus != nr_cpus) {
+		fprintf(stderr, "%s is a checkpoint on %u CPUs\n", resume_file, h.nr_cpus);
+		goto fail;
+	}
+	if (h.script_size != __script_size(filename)) {
+		fprintf(stderr, "%s is not the script of %s\n", filename, resume_file);
+		goto fail;
+	}
+
+	if (!__load_script(filename, true)) goto fail;
+
+	if (h.flags != __checkpoint_flags()) {
+		fprintf(stderr, "%s is made with different options. "
+				"Give the same -l, -m, and -R options\n", resume_file);
+		goto fail;
+	}
+
+	ticks = h.ticks;
+	__serialize(&ck);
+
+	if (ck.failed) goto corrupted;
+	if (sched->initialize && sched->initialize()) goto fail;
+	*initialized = true;
+	if (sched->serialize) sched->serialize(&ck);
+
+	if (!checkpoint_close(&ck, resume_file)) {
+		fprintf(stderr, "Checkpoint %s is corrupted\n", resume_file);
+		return false;
+	}
+
+	if (!quiet) fprintf(__sim->out, "Resumed at tick %u from %s\n\n", ticks, resume_file);
+	return true;
+
+corrupted:
+	fprintf(stderr, "Checkpoint %s is corrupted\n", resume_file);
+fail:
+	checkpoint_close(&ck, resume_file);
+	return false;
+}
+
+
+/***********************************************************************
+ * The main loop for the scheduler simulation
+ *
+ * On each tick, every CPU picks the process to run first, and then the CPUs
+ * run their processes one by one in the order of the CPU id. Thus, a CPU
+ * with a lower id wins when CPUs contend for a resource on the same tick.
+ */
+static bool __do_simulation(void)
+{
+	assert(sched->schedule && "scheduler.schedule() not implemented");
+
+	__next_checkpoint_at = __next_checkpoint(resume_file ? ticks + 1 : ticks);
+
+	while (true) {
+		if (ticks == __next_checkpoint_at) {
+			if (!__save_checkpoint()) return false;
+			__next_checkpoint_at = __next_checkpoint(ticks + 1);
+		}
+
+		/* Fork processes on schedule */
+		if (__fork_on_schedule() < 0) return false;
+
+		for (unsigned int cpu = 0; cpu < nr_cpus; cpu++) {
+			__switch_cpu(cpu);
+			if (!cpus[cpu].switching) __schedule_this_cpu();
+		}
+
+		/* Quit simulation if no pending process exists */
+		if (__all_cpus_idle() && list_empty(&__forkqueue)) {
+			break;
+		}
+
+		for (unsigned int cpu = 0; cpu < nr_cpus; cpu++) {
+			__switch_cpu(cpu);
+			__run_this_cpu();
+		}
+
+		/* Skip the ticks on which nothing happens */
+		if (event_driven && nr_cpus == 1) {
+			unsigned int nr = __nr_uneventful_ticks();
+
+			/* Do not skip the tick to write the checkpoint at */
+			if (nr > __next_checkpoint_at - ticks - 1) {
+				nr = __next_checkpoint_at - ticks - 1;
+			}
+			if (nr) __fast_forward(nr);
+		}
+
+		/* Increase the tick counter */
+		ticks++;
+	}
+	return true;
+}
+
+
+static void __initialize(void)
+{
+	INIT_LIST_HEAD(&readyqueue);
+	current = NULL;
+	ticks = 0;
+	this_cpu = 0;
+
+	for (int i = 0; i < MAX_NR_CPUS; i++) {
+		cpus[i].current = NULL;
+		INIT_LIST_HEAD(&cpus[i].readyqueue);
+		cpus[i].nr_idle = 0;
+		cpus[i].switching = cpus[i].nr_switching = 0;
+		cpus[i].vclock = 0.0;
+		cpus[i].nr_tickets = 0;
+		cpus[i].vclock_at = 0;
+	}
+
+	resources = NULL;
+	nr_resources = 0;
+	__metrics = NULL;
+	__nr_metrics = __max_metrics = 0;
+	__nr_inversions = 0;
+	__nr_total_inversions = 0;
+	__inversion_ticks = 0;
 
 	INIT_LIST_HEAD(&__forkqueue);
+	__nr_forked = 0;
+	INIT_LIST_HEAD(&__live_processes);
+	memset(&__workload, 0x00, sizeof(__workload));
+	memset(&__stats, 0x00, sizeof(__stats));
+	INIT_LIST_HEAD(&__free_processes);
+	INIT_LIST_HEAD(&__free_resource_schedules);
+
+	arena_init(&__process_arena);
+	arena_init(&__resource_schedule_arena);
+
+	if (quiet) return;
+	fprintf(__sim->out, "**************************************************************\n");
+	fprintf(__sim->out, "*\n");
+	fprintf(__sim->out, "*   Simulating %s scheduler", sched->name);
+	if (nr_cpus > 1) fprintf(__sim->out, " on %u CPUs", nr_cpus);
+	fprintf(__sim->out, "\n");
+	fprintf(__sim->out, "*\n");
+	fprintf(__sim->out, "**************************************************************\n");
+	fprintf(__sim->out, "   N: Forked\n");
+	fprintf(__sim->out, "   X: Finished\n");
+	fprintf(__sim->out, "   =: Blocked\n");
+	fprintf(__sim->out, "  +n: Acquire resource n\n");
+	fprintf(__sim->out, "  -n: Release resource n\n");
+	if (switch_cost || migrate_switch_cost) {
+		fprintf(__sim->out, "   ~: Switching to the process\n");
+	}
+	fprintf(__sim->out, "\n");
+}
+
+
+static void __report_cpus(void)
+{
+	bool switching = switch_cost || migrate_switch_cost;
+
+	if (quiet || (nr_cpus == 1 && !switching)) return;
+
+	fprintf(__sim->out, "\n");
+	fprintf(__sim->out, "***** CPU UTILIZATION *********\n");
+	for (unsigned int i = 0; i < nr_cpus; i++) {
+		fprintf(__sim->out, "CPU %2u: idle for %u of %u ticks (%.1f%%)",
+				i, cpus[i].nr_idle, ticks,
+				ticks ? 100.0 * cpus[i].nr_idle / ticks : 0.0);
+		if (switching) {
+			fprintf(__sim->out, ", switching for %u ticks (%.1f%%)",
+					cpus[i].nr_switching,
+					ticks ? 100.0 * cpus[i].nr_switching / ticks : 0.0);
+		}
+		fprintf(__sim->out, "\n");
+	}
+}
+
+
+static int __compare_pid(const void *a, const void *b)
+{
+	const struct metrics *ma = a, *mb = b;
+
+	if (ma->pid != mb->pid) return (ma->pid > mb->pid) - (ma->pid < mb->pid);
+	return (ma->arrival > mb->arrival) - (ma->arrival < mb->arrival);
+}
 
-	if (quiet) return;
-	printf("**************************************************************\n");
-	printf("*\n");
-	printf("*   Simulating %s scheduler\n", sched->name);
-	printf("*\n");
-	printf("**************************************************************\n");
-	printf("   N: Forked\n");
-	printf("   X: Finished\n");
-	printf("   =: Blocked\n");
-	printf("  +n: Acquire resource n\n");
-	printf("  -n: Release resource n\n");
-	printf("\n");
+static int __compare_uint(const void *a, const void *b)
+{
+	unsigned int va = *(const unsigned int *)a, vb = *(const unsigned int *)b;
+
+	return (va > vb) - (va < vb);
+}
+
+/**
+ * Nearest-rank @percentile of @nr sorted @values
+ */
+static unsigned int __percentile(const unsigned int *values, unsigned long nr,
+		unsigned int percentile)
+{
+	unsigned long rank = (nr * percentile + 99) / 100;
+
+	return values[rank ? rank - 1 : 0];
+}
+
+/**
+ * Print the average, percentiles, and max of @values. @values gets sorted.
+ */
+static void __report_distribution(const char *name, unsigned int *values, unsigned long nr)
+{
+	static const unsigned int percentiles[] = { 50, 90, 99, 100 };
+	double sum = 0;
+
+	qsort(values, nr, sizeof(*values), __compare_uint);
+	for (unsigned long i = 0; i < nr; i++) {
+		sum += values[i];
+	}
+
+	fprintf(__sim->out, "%-11s %10.2f", name, sum / nr);
+	for (unsigned int i = 0; i < sizeof(percentiles) / sizeof(*percentiles); i++) {
+		fprintf(__sim->out, " %8u", __percentile(values, nr, percentiles[i]));
+	}
+	fprintf(__sim->out, "\n");
+}
+
+static void __report_metrics(void)
+{
+	unsigned int *values;
+
+	if (!show_metrics || !__nr_metrics) return;
+
+	qsort(__metrics, __nr_metrics, sizeof(*__metrics), __compare_pid);
+
+	fprintf(__sim->out, "\n");
+	fprintf(__sim->out, "***** METRICS *****************\n");
+	fprintf(__sim->out, "  pid  arrival first run completion turnaround response  waiting  blocked switches\n");
+	for (unsigned long i = 0; i < __nr_metrics; i++) {
+		struct metrics *m = __metrics + i;
+		unsigned int turnaround = m->completion - m->arrival;
+
+		fprintf(__sim->out, "%5u %8u %9u %10u %10u %8u %8u %8u %8u\n",
+				m->pid, m->arrival, m->first_run, m->completion, turnaround,
+				m->first_run - m->arrival,
+				turnaround - m->lifespan - m->nr_blocked,
+				m->nr_blocked, m->nr_switches);
+	}
+
+	fprintf(__sim->out, "\n");
+	fprintf(__sim->out, "               average      p50      p90      p99      max\n");
+
+	values = malloc(sizeof(*values) * __nr_metrics);
+	assert(values);
+
+#define REPORT_DISTRIBUTION(name, expr) \
+	do { \
+		for (unsigned long i = 0; i < __nr_metrics; i++) { \
+			struct metrics *m = __metrics + i; \
+			values[i] = (expr); \
+		} \
+		__report_distribution(name, values, __nr_metrics); \
+	} while (0)
+
+	REPORT_DISTRIBUTION("Turnaround", m->completion - m->arrival);
+	REPORT_DISTRIBUTION("Response", m->first_run - m->arrival);
+	REPORT_DISTRIBUTION("Waiting", m->completion - m->arrival - m->lifespan - m->nr_blocked);
+	REPORT_DISTRIBUTION("Blocked", m->nr_blocked);
+	REPORT_DISTRIBUTION("Switches", m->nr_switches);
+
+#undef REPORT_DISTRIBUTION
+
+	free(values);
+
+	if (!sched->tickets) return;
+
+	/**
+	 * The requested share is what the tickets entitled the process to while
+	 * it was runnable, and the achieved one is what it actually ran for
+	 */
+	fprintf(__sim->out, "\n");
+	fprintf(__sim->out, "***** CPU SHARES **************\n");
+	fprintf(__sim->out, "  pid  tickets runnable requested achieved    ratio\n");
+	for (unsigned long i = 0; i < __nr_metrics; i++) {
+		struct metrics *m = __metrics + i;
+		unsigned int runnable = m->completion - m->arrival - m->nr_blocked;
+
+		fprintf(__sim->out, "%5u %8u %8u %8.1f%% %7.1f%% %8.2f\n",
+				m->pid, m->tickets, runnable,
+				runnable ? 100.0 * m->entitled / runnable : 0.0,
+				runnable ? 100.0 * m->lifespan / runnable : 0.0,
+				m->entitled ? m->lifespan / m->entitled : 0.0);
+	}
+}
+
+static void __report_resources(void)
+{
+	if (!profile_resources) return;
+
+	fprintf(__sim->out, "\n");
+	fprintf(__sim->out, "***** RESOURCES ***************\n");
+	fprintf(__sim->out, " id acquired contended    hold  hold/acq waiters(avg) waiters(max) wait(avg) wait(max)\n");
+	__sort_active_resources();
+	for (unsigned int j = 0; j < __nr_active_resources; j++) {
+		unsigned int i = __active_resources[j];
+		struct resource_profile *rp = __resource_profiles + i;
+
+		if (!rp->nr_acquisitions && !rp->nr_contended) continue;
+
+		__update_waiters(rp, 0);
+		fprintf(__sim->out, "%3u %8lu %9lu %7llu %9.2f %12.2f %12u %9.2f %9u\n",
+				i, rp->nr_acquisitions, rp->nr_contended, rp->hold_ticks,
+				rp->nr_acquisitions ? (double)rp->hold_ticks / rp->nr_acquisitions : 0.0,
+				ticks ? (double)rp->waiters_ticks / ticks : 0.0, rp->max_waiters,
+				rp->nr_contended ? (double)rp->wait_ticks / rp->nr_contended : 0.0,
+				rp->max_wait);
+	}
+
+	fprintf(__sim->out, "\n");
+	fprintf(__sim->out, "Priority inversions: %lu\n", __nr_total_inversions);
+	if (!__nr_inversions) return;
+
+	fprintf(__sim->out, " id  pid(prio)  owner(prio)    since    ticks\n");
+	for (unsigned int i = 0; i < __nr_inversions; i++) {
+		struct inversion *in = __inversions + i;
+
+		fprintf(__sim->out, "%3u %5u(%3u) %7u(%3u) %8u %8u\n",
+				in->resource_id, in->pid, in->prio, in->owner_pid, in->owner_prio,
+				in->since, in->duration);
+	}
+}
+
+/**
+ * Hand the metrics over to @result to compare with the other simulations
+ */
+static void __keep_results(struct comparison *result)
+{
+	qsort(__metrics, __nr_metrics, sizeof(*__metrics), __compare_pid);
+
+	result->ticks = ticks;
+	result->metrics = __metrics;
+	result->nr_metrics = __nr_metrics;
+	result->nr_inversions = __nr_total_inversions;
+	result->inversion_ticks = __inversion_ticks;
+
+	__metrics = NULL;
+	__nr_metrics = __max_metrics = 0;
+}
+
+static void __report_stats(void)
+{
+	struct rusage usage;
+	double seconds = __stats.simulation_ns / 1e9;
+
+	if (!show_stats) return;
+
+	getrusage(RUSAGE_SELF, &usage);
+
+	fprintf(__sim->out, "\n");
+	fprintf(__sim->out, "***** STATISTICS **************\n");
+	fprintf(__sim->out, "Ticks          : %u\n", ticks);
+	fprintf(__sim->out, "Processes      : %u\n", __nr_forked);
+	fprintf(__sim->out, "Simulation time: %.6f s\n", seconds);
+	fprintf(__sim->out, "Ticks/second   : %.0f\n", seconds ? ticks / seconds : 0.0);
+	fprintf(__sim->out, "schedule()     : %lu calls\n", __stats.nr_schedules);
+	fprintf(__sim->out, "ns/schedule()  : %.1f\n", __stats.nr_schedules ?
+			(double)__stats.schedule_ns / __stats.nr_schedules : 0.0);
+	fprintf(__sim->out, "Peak RSS       : %ld KB\n", usage.ru_maxrss);
+	fprintf(__sim->out, "Allocations    : %lu\n", __stats.nr_allocs);
 }
 
 
 static void __print_usage(char * const name)
 {
-	printf("Usage: %s {-q} -[f|s|S|r|p|i] [process script file]\n", name);
+	printf("Usage: %s {-q} {-e|-z} {-l} {-m} {-R} {-t} {-c N} {-M N} {-Q N} {-x N} {-X N} {-n N} {-o trace} -[f|s|S|r|p|i|C|F|d|L|V|w] [process script file]\n", name);
+	printf("       %s {-j N} -b [output dir] -[f|s|S|r|p|i|C|F|d|L|V|w]... [process script file]...\n", name);
+	printf("       %s --compile [process script file] -o [workload image]\n", name);
+	printf("       %s --checkpoint [checkpoint] {--checkpoint-at N} {--checkpoint-every N}\n", name);
+	printf("          {--resume [checkpoint]} {options} -[f|s|S|...] [process script file]\n");
+	printf("       %s --compare {-j N} {options} -[f|s|S|r|p|i|C|F|d|L|V|w]... [process script file]\n", name);
 	printf("\n");
-	printf("  -q: Run quietly\n\n");
+	printf("  A workload image made with --compile can be given as the script file\n\n");
+	printf("  -q: Run quietly\n");
+	printf("  -e: Skip uneventful ticks (event-driven simulation)\n");
+	printf("  -z: Skip uneventful ticks and print them in one line\n");
+	printf("  -l: Stream the script sorted by the start time as the simulation goes\n");
+	printf("  -m: Report the scheduling metrics of processes (even with -q)\n");
+	printf("  -R: Report the contention of resources (even with -q)\n");
+	printf("  -t: Report the statistics of the simulator (even with -q)\n");
+	printf("  -c: Simulate N CPUs (1 by default, up to %d)\n", MAX_NR_CPUS);
+	printf("  -M: Take N ticks to migrate a process to another CPU\n");
+	printf("  -Q: Give N-tick time slices to round-robin and priority schedulers\n");
+	printf("      (1 by default)\n");
+	printf("  -x: Take N ticks to switch to another process\n");
+	printf("  -X: Take N more ticks to switch to a process that ran on another CPU\n");
+	printf("  -n: Simulate N resources (as many as the script uses by default,\n");
+	printf("      at least %d, and %d in the streaming mode)\n", NR_RESOURCES, NR_RESOURCES);
+	printf("  -o: Write the trace into the file in the binary format (see tracedump)\n");
+	printf("  -b: Simulate all pairs of given scripts and schedulers into the dir\n");
+	printf("  -j: Run N simulations in parallel in the batch mode\n");
+	printf("  --checkpoint: Write the state of the simulation into the checkpoint\n");
+	printf("      at tick N (--checkpoint-at) and/or on every N ticks\n");
+	printf("      (--checkpoint-every), replacing the previous one\n");
+	printf("  --resume: Resume the simulation from the checkpoint. Give the same\n");
+	printf("      script, scheduler, and -c, -l, -m, and -R options\n");
+	printf("  --compare: Simulate the script with all given schedulers at once and\n");
+	printf("      report only how they compare with the first one\n\n");
 	printf("  -f: Use FIFO scheduler (default)\n");
 	printf("  -s: Use SJF scheduler\n");
 	printf("  -S: Use SRTF scheduler\n");
 	printf("  -r: Use Round-robin scheduler\n");
 	printf("  -p: Use Priority scheduler\n");
-	printf("  -i: Use Priority with PIP scheduler\n\n");
+	printf("  -i: Use Priority with PIP scheduler\n");
+	printf("  -C: Use Priority with priority ceiling scheduler\n");
+	printf("  -F: Use Multi-level feedback queue scheduler\n");
+	printf("  -d: Use Stride scheduler\n");
+	printf("  -L: Use Lottery scheduler\n");
+	printf("  -V: Use Completely fair scheduler\n");
+	printf("  -w: Use Work-stealing scheduler\n\n");
+}
+
+
+/**
+ * Load the script and simulate it with the scheduler as @sim describes
+ */
+static int __simulate(struct simulation *sim)
+{
+	int ret = EXIT_FAILURE;
+	bool initialized = false;
+
+	__sim = sim;
+	sched = instrument_scheduler(sim->sched);
+
+	if (!sim->trace) {
+		/* Nothing to write */
+	} else if (sim->binary) {
+		trace_open_binary(&__trace, sim->trace, nr_cpus > 1);
+	} else {
+		trace_open(&__trace, sim->trace, nr_cpus > 1);
+	}
+	__initialize();
+
+	if (resume_file) {
+		if (!__resume(sim->scriptfile, &initialized)) goto out;
+	} else {
+		if (!__load_script(sim->scriptfile, false)) {
+			goto out;
+		}
+
+		if (sched->initialize && sched->initialize()) {
+			goto out;
+		}
+		initialized = true;
+	}
+
+	__stats.simulation_ns = __now_ns();
+	if (!__do_simulation()) {
+		goto out;
+	}
+	__stats.simulation_ns = __now_ns() - __stats.simulation_ns;
+	__stats.nr_allocs = __process_arena.nr_chunks + __resource_schedule_arena.nr_chunks;
+
+	if (sim->result) {
+		__keep_results(sim->result);
+	} else {
+		__report_cpus();
+		__report_metrics();
+		__report_resources();
+		__report_stats();
+		instrument_report(__sim->out);
+	}
+
+	ret = EXIT_SUCCESS;
+
+out:
+	/* Release what the scheduler allocated even if the simulation failed */
+	if (initialized && sched->finalize) {
+		sched->finalize();
+	}
+	if (sim->trace) trace_close(&__trace);
+	free(__metrics);
+	__free_resources();
+	__unload_workload();
+	arena_destroy(&__process_arena);
+	arena_destroy(&__resource_schedule_arena);
+
+	return ret;
+}
+
+
+/**
+ * Compile @scriptfile into the workload image @imagefile, or into the memory
+ * allocated at *@image and *@size if @imagefile is NULL
+ */
+static int __compile(char *scriptfile, char *imagefile, char **image, size_t *size)
+{
+	struct simulation sim = {
+		.scriptfile = scriptfile,
+		.out = stdout,
+	};
+	struct workload_header h = {
+		.magic = WORKLOAD_MAGIC,
+		.version = WORKLOAD_VERSION,
+		.byte_order = WORKLOAD_BYTE_ORDER,
+	};
+	struct process *p;
+	struct resource_schedule *rs;
+	uint64_t nr_schedules = 0;
+	int ret = EXIT_FAILURE;
+	FILE *file;
+
+	__sim = &sim;
+	quiet = true;
+	__initialize();
+
+	if (!__load_script(scriptfile, false) || !__fetch_workload(UINT_MAX)) {
+		goto out;
+	}
+
+	file = imagefile ? fopen(imagefile, "w") : open_memstream(image, size);
+	if (!file) {
+		fprintf(stderr, "Unable to open %s\n", imagefile ? imagefile : "the image");
+		goto out;
+	}
+
+	h.nr_resources = __workload.nr_resources;
+	h.nr_declarations = __workload.nr_declarations;
+	list_for_each_entry(p, &__forkqueue, list) {
+		h.nr_processes++;
+		list_for_each_entry(rs, &p->__resources_to_acquire, list) {
+			h.nr_schedules++;
+		}
+	}
+	fwrite(&h, sizeof(h), 1, file);
+
+	list_for_each_entry(p, &__forkqueue, list) {
+		struct workload_process wp = {
+			.pid = p->pid,
+			.starts_at = p->__starts_at,
+			.lifespan = p->lifespan,
+			.prio = p->prio_orig,
+			.schedule = nr_schedules,
+		};
+		list_for_each_entry(rs, &p->__resources_to_acquire, list) {
+			wp.nr_schedules++;
+		}
+		nr_schedules += wp.nr_schedules;
+		fwrite(&wp, sizeof(wp), 1, file);
+	}
+
+	list_for_each_entry(p, &__forkqueue, list) {
+		list_for_each_entry(rs, &p->__resources_to_acquire, list) {
+			struct workload_schedule ws = {
+				.resource_id = rs->resource_id,
+				.at = rs->at,
+				.duration = rs->duration,
+				.flags = rs->shared ? WORKLOAD_SCHEDULE_SHARED : 0,
+			};
+			fwrite(&ws, sizeof(ws), 1, file);
+		}
+	}
+	if (__workload.nr_declarations) {
+		fwrite(__workload.declarations, sizeof(*__workload.declarations),
+				__workload.nr_declarations, file);
+	}
+
+	if (ferror(file) | fclose(file)) {
+		fprintf(stderr, "Unable to write %s\n", imagefile ? imagefile : "the image");
+		if (!imagefile) free(*image);
+		goto out;
+	}
+	ret = EXIT_SUCCESS;
+
+out:
+	__free_resources();
+	__unload_workload();
+	arena_destroy(&__process_arena);
+	arena_destroy(&__resource_schedule_arena);
+
+	return ret;
+}
+
+
+/***********************************************************************
+ * Batch mode
+ *
+ * Simulate every pair of the given scripts and schedulers on a pool of
+ * threads. The messages and the trace of each pair are written to
+ * @outdir/<script>.<option>.out and @outdir/<script>.<option>.err,
+ * respectively, as if they were redirected from stdout and stderr.
+ */
+static struct simulation *__batch;
+static unsigned int __nr_batch = 0;
+static unsigned int __next_batch = 0;
+static bool __batch_failed = false;
+static pthread_mutex_t __batch_lock = PTHREAD_MUTEX_INITIALIZER;
+static char *__batch_outdir;
+
+static int __scheduler_option(struct scheduler *s)
+{
+	for (int i = 0; i < NR_SCHEDULERS; i++) {
+		if (__schedulers[i].sched == s) return __schedulers[i].option;
+	}
+	return 0;
+}
+
+static const char *__script_name(const char *scriptfile)
+{
+	const char *name = strrchr(scriptfile, '/');
+
+	return name ? name + 1 : scriptfile;
+}
+
+static FILE *__open_batch_output(struct simulation *sim, const char *suffix)
+{
+	char path[4096];
+
+	snprintf(path, sizeof(path), "%s/%s.%c.%s", __batch_outdir,
+			__script_name(sim->scriptfile), __scheduler_option(sim->sched), suffix);
+	return fopen(path, "w");
+}
+
+static void *__batch_worker(void *arg)
+{
+	(void)arg;
+
+	while (true) {
+		struct simulation *sim;
+		int ret = EXIT_FAILURE;
+
+		pthread_mutex_lock(&__batch_lock);
+		if (__next_batch == __nr_batch) {
+			pthread_mutex_unlock(&__batch_lock);
+			break;
+		}
+		sim = __batch + __next_batch++;
+		pthread_mutex_unlock(&__batch_lock);
+
+		if (sim->result) {
+			/* Only the results are kept for the comparison */
+			ret = __simulate(sim);
+		} else {
+			sim->out = __open_batch_output(sim, "out");
+			sim->trace = __open_batch_output(sim, "err");
+
+			if (sim->out && sim->trace) {
+				ret = __simulate(sim);
+			}
+			if (sim->out) fclose(sim->out);
+			if (sim->trace) fclose(sim->trace);
+		}
+
+		if (ret != EXIT_SUCCESS) {
+			pthread_mutex_lock(&__batch_lock);
+			fprintf(stderr, "Failed to simulate %s with %s scheduler\n",
+					sim->scriptfile, sim->sched->name);
+			__batch_failed = true;
+			pthread_mutex_unlock(&__batch_lock);
+		}
+	}
+	return NULL;
+}
+
+/**
+ * Run the simulations in __batch[] on @nr_threads threads
+ */
+static int __run_batch_workers(int nr_threads)
+{
+	pthread_t *threads;
+	int nr_created = 0;
+
+	if (nr_threads < 1) nr_threads = 1;
+	if ((unsigned int)nr_threads > __nr_batch) nr_threads = __nr_batch;
+
+	threads = malloc(sizeof(*threads) * nr_threads);
+	if (!threads) {
+		fprintf(stderr, "Unable to create worker threads\n");
+		return EXIT_FAILURE;
+	}
+
+	/* Go on with the threads created so far if some cannot be created */
+	while (nr_created < nr_threads &&
+			!pthread_create(threads + nr_created, NULL, __batch_worker, NULL)) {
+		nr_created++;
+	}
+	if (!nr_created) {
+		fprintf(stderr, "Unable to create worker threads\n");
+		free(threads);
+		return EXIT_FAILURE;
+	}
+	for (int i = 0; i < nr_created; i++) {
+		pthread_join(threads[i], NULL);
+	}
+
+	free(threads);
+
+	return __batch_failed ? EXIT_FAILURE : EXIT_SUCCESS;
+}
+
+static int __run_batch(char *outdir, char * const scripts[], int nr_scripts,
+		struct scheduler *scheds[], int nr_scheds, int nr_threads)
+{
+	int ret;
+
+	/* The outputs are named after the scripts, so the names should not clash */
+	for (int i = 0; i < nr_scripts; i++) {
+		for (int j = 0; j < i; j++) {
+			if (strcmp(__script_name(scripts[i]), __script_name(scripts[j]))) continue;
+
+			fprintf(stderr, "%s and %s would be simulated into the same files\n",
+					scripts[j], scripts[i]);
+			return EXIT_FAILURE;
+		}
+	}
+
+	__batch_outdir = outdir;
+	__batch = calloc(nr_scripts * nr_scheds, sizeof(*__batch));
+	for (int i = 0; i < nr_scripts; i++) {
+		for (int j = 0; j < nr_scheds; j++) {
+			struct simulation *sim = __batch + __nr_batch++;
+			sim->scriptfile = scripts[i];
+			sim->sched = scheds[j];
+			sim->binary = false;
+		}
+	}
+
+	ret = __run_batch_workers(nr_threads);
+	free(__batch);
+
+	return ret;
+}
+
+
+/***********************************************************************
+ * Comparison mode
+ *
+ * Simulate the script with each of the given schedulers side by side, and
+ * report only how they compare. The script is parsed once into a workload
+ * image in the memory, which the simulations share read-only. No trace is
+ * made, and the metrics and the inversions kept by the simulations are
+ * compared against the first scheduler given.
+ */
+static void __report_comparison(struct scheduler *scheds[], struct comparison *results,
+		int nr_scheds)
+{
+	struct comparison *base = results;
+	unsigned long max_metrics = 1;
+	unsigned long *next = calloc(nr_scheds, sizeof(*next));
+	unsigned int *values;
+
+	for (int j = 0; j < nr_scheds; j++) {
+		if (results[j].nr_metrics > max_metrics) max_metrics = results[j].nr_metrics;
+	}
+	values = malloc(sizeof(*values) * max_metrics);
+	assert(next && values);
+
+	printf("***** COMPARISON **************\n");
+	printf("     ticks finished proc/tick turnaround wait(avg) wait(p99) inversions inv.ticks  scheduler\n");
+	for (int j = 0; j < nr_scheds; j++) {
+		struct comparison *r = results + j;
+		double turnaround = 0, waiting = 0;
+
+		for (unsigned long i = 0; i < r->nr_metrics; i++) {
+			struct metrics *m = r->metrics + i;
+
+			values[i] = m->completion - m->arrival - m->lifespan - m->nr_blocked;
+			turnaround += m->completion - m->arrival;
+			waiting += values[i];
+		}
+		qsort(values, r->nr_metrics, sizeof(*values), __compare_uint);
+
+		printf("%10u %8lu %9.4f %10.2f %9.2f %9u %10lu %9llu  -%c %s\n",
+				r->ticks, r->nr_metrics,
+				r->ticks ? (double)r->nr_metrics / r->ticks : 0.0,
+				r->nr_metrics ? turnaround / r->nr_metrics : 0.0,
+				r->nr_metrics ? waiting / r->nr_metrics : 0.0,
+				r->nr_metrics ? __percentile(values, r->nr_metrics, 99) : 0,
+				r->nr_inversions, r->inversion_ticks,
+				__scheduler_option(scheds[j]), scheds[j]->name);
+	}
+
+	/**
+	 * The completion times relative to the first scheduler. Processes left
+	 * unfinished (e.g., deadlocked) are marked with '-', and the completion
+	 * times are given as they are, without the sign, if the first scheduler
+	 * left the process unfinished.
+	 */
+	printf("\n");
+	printf("***** COMPLETION **************\n");
+	printf("  pid");
+	for (int j = 0; j < nr_scheds; j++) {
+		char label[4];
+
+		snprintf(label, sizeof(label), "-%c", __scheduler_option(scheds[j]));
+		printf(j ? " %10s" : " %11s", label);
+	}
+	printf("\n");
+
+	while (true) {
+		struct metrics *first = NULL, *b;
+
+		/* The metrics are sorted, so merge them by the pid */
+		for (int j = 0; j < nr_scheds; j++) {
+			struct metrics *m = results[j].metrics + next[j];
+
+			if (next[j] == results[j].nr_metrics) continue;
+			if (!first || __compare_pid(m, first) < 0) first = m;
+		}
+		if (!first) break;
+
+		b = next[0] < base->nr_metrics && !__compare_pid(base->metrics + next[0], first) ?
+				base->metrics + next[0] : NULL;
+
+		printf("%5u", first->pid);
+		for (int j = 0; j < nr_scheds; j++) {
+			struct metrics *m = results[j].metrics + next[j];
+
+			if (next[j] == results[j].nr_metrics || __compare_pid(m, first)) {
+				printf(j ? " %10s" : " %11s", "-");
+				continue;
+			}
+			next[j]++;
+
+			if (!j) {
+				printf(" %11u", m->completion);
+			} else if (b) {
+				printf(" %+10lld", (long long)m->completion - b->completion);
+			} else {
+				printf(" %10u", m->completion);
+			}
+		}
+		printf("\n");
+	}
+
+	free(values);
+	free(next);
+}
+
+static int __run_comparison(char *scriptfile, struct scheduler *scheds[], int nr_scheds,
+		int nr_threads)
+{
+	struct comparison *results;
+	char *image = NULL;
+	size_t size = 0;
+	int ret;
+
+	if (__compile(scriptfile, NULL, &image, &size) != EXIT_SUCCESS) {
+		return EXIT_FAILURE;
+	}
+
+	results = calloc(nr_scheds, sizeof(*results));
+	__batch = calloc(nr_scheds, sizeof(*__batch));
+	for (int j = 0; j < nr_scheds; j++) {
+		struct simulation *sim = __batch + __nr_batch++;
+		sim->scriptfile = scriptfile;
+		sim->sched = scheds[j];
+		sim->out = stderr;
+		sim->image = image;
+		sim->image_size = size;
+		sim->result = results + j;
+	}
+
+	ret = __run_batch_workers(nr_threads);
+	if (ret == EXIT_SUCCESS) {
+		__report_comparison(scheds, results, nr_scheds);
+	}
+
+	for (int j = 0; j < nr_scheds; j++) {
+		free(results[j].metrics);
+	}
+	free(results);
+	free(__batch);
+	free(image);
+
+	return ret;
 }
 
 
+enum {
+	OPT_COMPILE = 0x100,
+	OPT_CHECKPOINT,
+	OPT_CHECKPOINT_AT,
+	OPT_CHECKPOINT_EVERY,
+	OPT_RESUME,
+	OPT_COMPARE,
+};
+
+static const struct option __long_options[] = {
+	{ "compile", required_argument, NULL, OPT_COMPILE },
+	{ "checkpoint", required_argument, NULL, OPT_CHECKPOINT },
+	{ "checkpoint-at", required_argument, NULL, OPT_CHECKPOINT_AT },
+	{ "checkpoint-every", required_argument, NULL, OPT_CHECKPOINT_EVERY },
+	{ "resume", required_argument, NULL, OPT_RESUME },
+	{ "compare", no_argument, NULL, OPT_COMPARE },
+	{ NULL, 0, NULL, 0 },
+};
+
 int main(int argc, char * const argv[])
 {
 	int opt;
-	char *scriptfile;
+	struct scheduler *scheds[NR_SCHEDULERS];
+	int nr_scheds = 0;
+	char *outdir = NULL;
+	char *outfile = NULL;	/* The trace, or the image with --compile */
+	char *compile = NULL;
+	bool compare = false;
+	int nr_threads = sysconf(_SC_NPROCESSORS_ONLN);
+
+	while ((opt = getopt_long(argc, argv, "qezltmRc:M:Q:x:X:n:b:j:o:fsSrpiCFdLVwh",
+					__long_options, NULL)) != -1) {
+		struct scheduler *s = NULL;
 
-	while ((opt = getopt(argc, argv, "qfsSrpih")) != -1) {
 		switch (opt) {
 		case 'q':
 			quiet = true;
 			break;
-
-		case 'f':
-			sched = &fifo_scheduler;
+		case 'z':
+			compress_trace = true;
+			/* Fall through */
+		case 'e':
+			event_driven = true;
 			break;
-		case 's':
-			sched = &sjf_scheduler;
+		case 'l':
+			streaming = true;
 			break;
-		case 'S':
-			sched = &srtf_scheduler;
+		case 't':
+			show_stats = true;
 			break;
-		case 'r':
-			sched = &rr_scheduler;
+		case 'm':
+			show_metrics = true;
 			break;
-		case 'p':
-			sched = &prio_scheduler;
+		case 'R':
+			profile_resources = true;
+			break;
+		case 'c':
+			nr_cpus = atoi(optarg);
+			if (nr_cpus < 1 || nr_cpus > MAX_NR_CPUS) {
+				__print_usage(argv[0]);
+				return EXIT_FAILURE;
+			}
+			break;
+		case 'M':
+			migration_cost = atoi(optarg);
+			break;
+		case 'x':
+			switch_cost = atoi(optarg);
+			break;
+		case 'X':
+			migrate_switch_cost = atoi(optarg);
+			break;
+		case 'Q':
+			quantum = atoi(optarg);
+			if (quantum < 1) {
+				__print_usage(argv[0]);
+				return EXIT_FAILURE;
+			}
+			break;
+		case 'n':
+			max_resources = atoi(optarg);
+			if (max_resources < 1 || max_resources > MAX_NR_RESOURCES) {
+				__print_usage(argv[0]);
+				return EXIT_FAILURE;
+			}
+			break;
+		case 'b':
+			outdir = optarg;
+			break;
+		case 'j':
+			nr_threads = atoi(optarg);
+			break;
+		case 'o':
+			outfile = optarg;
+			break;
+		case OPT_COMPILE:
+			compile = optarg;
+			break;
+		case OPT_CHECKPOINT:
+			checkpoint_file = optarg;
 			break;
-		case 'i':
-			sched = &pip_scheduler;
+		case OPT_CHECKPOINT_AT:
+			checkpoint_at = atoi(optarg);
 			break;
-		case 'h':
+		case OPT_CHECKPOINT_EVERY:
+			checkpoint_every = atoi(optarg);
+			if (checkpoint_every < 1) {
+				__print_usage(argv[0]);
+				return EXIT_FAILURE;
+			}
+			break;
+		case OPT_RESUME:
+			resume_file = optarg;
+			break;
+		case OPT_COMPARE:
+			compare = true;
+			break;
+
 		default:
+			for (int i = 0; i < NR_SCHEDULERS; i++) {
+				if (__schedulers[i].option == opt) s = __schedulers[i].sched;
+			}
+			if (!s) {
+				__print_usage(argv[0]);
+				return EXIT_FAILURE;
+			}
+
+			/**
+			 * Pick up the last one, or collect all of them in the batch mode.
+			 * A repeated option is moved to the end so that the last one wins
+			 */
+			for (int i = 0; i < nr_scheds; i++) {
+				if (scheds[i] != s) continue;
+				memmove(scheds + i, scheds + i + 1, sizeof(*scheds) * (nr_scheds - i - 1));
+				nr_scheds--;
+				break;
+			}
+			scheds[nr_scheds++] = s;
+			break;
+		}
+	}
+
+	if (compile) {
+		if (!outfile || optind < argc) {
 			__print_usage(argv[0]);
 			return EXIT_FAILURE;
 		}
+		return __compile(compile, outfile, NULL, NULL);
 	}
 
 	if (optind >= argc) {
@@ -470,25 +3400,57 @@ int main(int argc, char * const argv[])
 		return EXIT_FAILURE;
 	}
 
-	scriptfile = argv[optind];
-
-	__initialize();
+	if (!nr_scheds) {
+		scheds[nr_scheds++] = &fifo_scheduler;
+	}
 
-	if (!__load_script(scriptfile)) {
+	/* Tell when to checkpoint, and only for a single simulation */
+	if (!checkpoint_file != (checkpoint_at == UINT_MAX && !checkpoint_every) ||
+			(outdir && (checkpoint_file || resume_file))) {
+		__print_usage(argv[0]);
 		return EXIT_FAILURE;
 	}
 
-	if (sched->initialize && sched->initialize()) {
-		return EXIT_FAILURE;
+	if (compare) {
+		if (nr_scheds < 2 || optind + 1 != argc || outdir || outfile ||
+				checkpoint_file || resume_file) {
+			__print_usage(argv[0]);
+			return EXIT_FAILURE;
+		}
+		show_metrics = profile_resources = true;
+		return __run_comparison(argv[optind], scheds, nr_scheds, nr_threads);
 	}
 
-	__do_simulation();
+	if (outdir) {
+		if (outfile) {
+			__print_usage(argv[0]);
+			return EXIT_FAILURE;
+		}
+		return __run_batch(outdir, argv + optind, argc - optind,
+				scheds, nr_scheds, nr_threads);
+	} else {
+		struct simulation sim = {
+			.scriptfile = argv[optind],
+			.sched = scheds[nr_scheds - 1],
+			.out = stdout,
+			.trace = stderr,
+		};
+		int ret;
+
+		if (outfile) {
+			sim.trace = fopen(outfile, "w");
+			sim.binary = true;
+			if (!sim.trace) {
+				fprintf(stderr, "Unable to open %s\n", outfile);
+				return EXIT_FAILURE;
+			}
+		}
 
-	if (sched->finalize) {
-		sched->finalize();
-	}
+		ret = __simulate(&sim);
 
-	return EXIT_SUCCESS;
+		if (outfile) fclose(sim.trace);
+		return ret;
+	}
 }
 /*          ******        DO NOT MODIFY THIS FILE        ******       */
 /*====================================================================*/
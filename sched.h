@@ -16,6 +16,29 @@
 #ifndef __SCHED_H__
 #define __SCHED_H__
 
+/**
+ * Maximum number of CPUs to simulate with -c option
+ */
+#define MAX_NR_CPUS	256
+
+struct checkpoint;
+
+/***********************************************************************
+ * enum tickless_mode
+ *
+ * DESCRIPTION
+ *   Describes when the framework may fast-forward ticks without calling
+ *   schedule() in the event-driven mode (-e). Ticks are only skipped until
+ *   the next event (fork, acquire, release, or exit) of the system, so the
+ *   mode only tells whether the policy keeps @current running in between.
+ *   Idle ticks are always skipped since there is nothing to schedule.
+ */
+enum tickless_mode {
+	TICKLESS_NEVER = 0,	/* schedule() should be called on every tick */
+	TICKLESS_ALONE,		/* @current keeps running if no one else is ready */
+	TICKLESS_ALWAYS,	/* @current keeps running until it exits or blocks */
+};
+
 /***********************************************************************
  * struct scheduler
  *
@@ -23,10 +46,26 @@
  *   This structure is a collection of callback functions for a scheduler..
  *   Apply your scheduling policy by assigining appropriate functions to
  *   the function pointers.
+ *
+ *   When the system has more than one CPU (-c option), the callbacks are
+ *   called on behalf of a CPU, which is given by @this_cpu. @current and
+ *   @readyqueue refer to those of @this_cpu during the callbacks, so a policy
+ *   with per-CPU data structures should index them by @this_cpu. A process
+ *   stays on its @cpu until the policy migrates it in balance().
  */
 struct scheduler {
 	const char *name;
 
+	/***********************************************************************
+	 * enum tickless_mode tickless
+	 *
+	 * DESCRIPTION
+	 *   Tells the framework when the scheduling decision is deterministic
+	 *   so that it can skip calling schedule() on uneventful ticks. Leave it
+	 *   zero (TICKLESS_NEVER) if schedule() should see every tick.
+	 */
+	enum tickless_mode tickless;
+
 	/***********************************************************************
 	 * int initialize(void)
 	 *
@@ -91,6 +130,33 @@ struct scheduler {
 	struct process *(*schedule)(void);
 
 
+	/***********************************************************************
+	 * unsigned int nr_ready(void)
+	 *
+	 * DESCRIPTION
+	 *   Policies keeping ready processes in their own data structure rather
+	 *   than in @readyqueue should implement this to tell how many processes
+	 *   are there. You may leave it NULL if you use @readyqueue only.
+	 *
+	 * RETURN
+	 *   # of ready processes in the policy's own data structure
+	 */
+	unsigned int (*nr_ready)(void);
+
+
+	/***********************************************************************
+	 * void balance(void)
+	 *
+	 * DESCRIPTION
+	 *   Called on each CPU before schedule() when the system has more than
+	 *   one CPU. The policy may migrate ready processes from other CPUs to
+	 *   @this_cpu (or vice versa) here. When migrating a process, move it to
+	 *   the ready queue of the destination CPU and update its @cpu. You may
+	 *   leave this function NULL to keep processes on their initial CPUs.
+	 */
+	void (*balance)(void);
+
+
 	/***********************************************************************
 	 * bool acquire(int resource_id)
 	 *
@@ -111,6 +177,59 @@ struct scheduler {
 	 *   Callbacked to release the resource @resource_id
 	 */
 	void (*release)(int);
+
+
+	/***********************************************************************
+	 * bool acquire_shared(int resource_id)
+	 * void release_shared(int resource_id)
+	 *
+	 * DESCRIPTION
+	 *   Same as acquire() and release() but for the rwlock @resource_id in
+	 *   the shared mode, which allows other processes to hold the resource in
+	 *   the shared mode at the same time. The framework calls acquire() and
+	 *   release() instead for the other kinds of resources.
+	 */
+	bool (*acquire_shared)(int);
+	void (*release_shared)(int);
+
+
+	/***********************************************************************
+	 * unsigned int tickets(struct process *process)
+	 *
+	 * DESCRIPTION
+	 *   Proportional-share policies should implement this to tell the number
+	 *   of tickets @process holds. The framework then reports the share of
+	 *   the CPU each process got against the share its tickets entitled it
+	 *   to among the runnable processes of its CPU (-m option). The number
+	 *   should not change while the process is runnable.
+	 */
+	unsigned int (*tickets)(struct process *);
+
+
+	/***********************************************************************
+	 * void serialize(struct checkpoint *checkpoint)
+	 *
+	 * DESCRIPTION
+	 *   Save the policy's own state into @checkpoint, or restore it from
+	 *   @checkpoint if @checkpoint->restoring, using the helpers in
+	 *   checkpoint.h (--checkpoint and --resume). The helpers work in both
+	 *   ways so that one function can do both. It is called after the state
+	 *   of the framework is saved, and after initialize() when restoring. The
+	 *   processes and their fields are restored by then, and so are the lists
+	 *   of the framework such as @readyqueue and @waitqueue of resources, but
+	 *   the processes are not linked into any data structure of the policy.
+	 *   Leave it NULL if the policy keeps nothing but in those.
+	 */
+	void (*serialize)(struct checkpoint *);
 };
 
+/***********************************************************************
+ * struct list_head *cpu_readyqueue(unsigned int cpu)
+ *
+ * DESCRIPTION
+ *   Get the ready queue of @cpu, which is @readyqueue if @cpu is @this_cpu.
+ *   Use this to wake up or to migrate processes onto other CPUs.
+ */
+struct list_head *cpu_readyqueue(unsigned int cpu);
+
 #endif
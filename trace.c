@@ -0,0 +1,240 @@
+/**********************************************************************
+ * Copyright (c) 2019
+ *  Sang-Hoon Kim <sanghoonkim@ajou.ac.kr>
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License version 2 as
+ * published by the Free Software Foundation.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTIABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+ * GNU General Public License for more details.
+ *
+ **********************************************************************/
+
+#include <stdlib.h>
+#include <string.h>
+#include <assert.h>
+#include <unistd.h>
+
+#include "types.h"
+#include "trace.h"
+
+/**
+ * Spaces to indent the events. Long indentations are copied in pieces.
+ * Initialized statically as traces are opened by many threads at once.
+ */
+#define INDENT_LEN	4096
+static const char __indent[INDENT_LEN] = { [0 ... INDENT_LEN - 1] = ' ' };
+
+void trace_open(struct trace *trace, FILE *file, bool show_cpu)
+{
+	fflush(file);
+	trace->fd = fileno(file);
+	trace->binary = false;
+	trace->show_cpu = show_cpu;
+	trace->autoflush = isatty(trace->fd);
+	trace->len = 0;
+	trace->buffer = malloc(TRACE_BUFFER_SIZE);
+	assert(trace->buffer);
+}
+
+static inline void __put_le(unsigned char *p, unsigned int value, int bytes)
+{
+	for (int i = 0; i < bytes; i++) {
+		p[i] = value >> (8 * i);
+	}
+}
+
+static inline unsigned int __get_le(const unsigned char *p, int bytes)
+{
+	unsigned int value = 0;
+
+	for (int i = 0; i < bytes; i++) {
+		value |= (unsigned int)p[i] << (8 * i);
+	}
+	return value;
+}
+
+void trace_open_binary(struct trace *trace, FILE *file, bool show_cpu)
+{
+	unsigned char header[TRACE_HEADER_SIZE];
+
+	trace_open(trace, file, show_cpu);
+	trace->binary = true;
+	trace->autoflush = false;
+
+	memcpy(header, TRACE_MAGIC, 8);
+	__put_le(header + 8, TRACE_VERSION, 4);
+	__put_le(header + 12, show_cpu, 4);
+	memcpy(trace->buffer, header, TRACE_HEADER_SIZE);
+	trace->len = TRACE_HEADER_SIZE;
+}
+
+bool trace_read_header(FILE *file, bool *show_cpu)
+{
+	unsigned char header[TRACE_HEADER_SIZE];
+
+	if (fread(header, TRACE_HEADER_SIZE, 1, file) != 1) return false;
+	if (memcmp(header, TRACE_MAGIC, 8)) return false;
+	if (__get_le(header + 8, 4) != TRACE_VERSION) return false;
+
+	*show_cpu = __get_le(header + 12, 4);
+	return true;
+}
+
+bool trace_read(FILE *file, struct trace_record *r)
+{
+	unsigned char buf[TRACE_RECORD_SIZE];
+
+	if (fread(buf, TRACE_RECORD_SIZE, 1, file) != 1) return false;
+
+	r->tick = __get_le(buf, 4);
+	r->pid = __get_le(buf + 4, 4);
+	r->arg = __get_le(buf + 8, 4);
+	r->cpu = __get_le(buf + 12, 2);
+	r->kind = buf[14];
+	return true;
+}
+
+void trace_flush(struct trace *trace)
+{
+	size_t written = 0;
+
+	while (written < trace->len) {
+		ssize_t ret = write(trace->fd, trace->buffer + written, trace->len - written);
+		if (ret <= 0) break;
+		written += ret;
+	}
+	trace->len = 0;
+}
+
+void trace_close(struct trace *trace)
+{
+	trace_flush(trace);
+	free(trace->buffer);
+	trace->buffer = NULL;
+}
+
+static inline void __trace_put(struct trace *trace, const char *str, size_t len)
+{
+	while (len) {
+		size_t n = TRACE_BUFFER_SIZE - trace->len;
+
+		if (n > len) n = len;
+		memcpy(trace->buffer + trace->len, str, n);
+		trace->len += n;
+		str += n;
+		len -= n;
+
+		if (trace->len == TRACE_BUFFER_SIZE) trace_flush(trace);
+	}
+}
+
+/**
+ * Put @value in decimal, padded with spaces up to @width
+ */
+static inline void __trace_put_uint(struct trace *trace, unsigned int value, int width)
+{
+	char buf[16];
+	char *p = buf + sizeof(buf);
+
+	do {
+		*--p = '0' + value % 10;
+		value /= 10;
+		width--;
+	} while (value);
+
+	while (width-- > 0) *--p = ' ';
+
+	__trace_put(trace, p, buf + sizeof(buf) - p);
+}
+
+static inline void __trace_put_indent(struct trace *trace, unsigned int pid)
+{
+	size_t len = 4 * (size_t)pid;
+
+	while (len) {
+		size_t n = len < INDENT_LEN ? len : INDENT_LEN;
+		__trace_put(trace, __indent, n);
+		len -= n;
+	}
+}
+
+static inline void __trace_put_repeats(struct trace *trace, unsigned int nr)
+{
+	if (nr > 1) {
+		__trace_put(trace, " x", 2);
+		__trace_put_uint(trace, nr, 0);
+	}
+}
+
+static inline void __trace_put_binary(struct trace *trace, const struct trace_record *r)
+{
+	unsigned char buf[TRACE_RECORD_SIZE];
+
+	__put_le(buf, r->tick, 4);
+	__put_le(buf + 4, r->pid, 4);
+	__put_le(buf + 8, r->arg, 4);
+	__put_le(buf + 12, r->cpu, 2);
+	buf[14] = r->kind;
+	buf[15] = 0;
+
+	__trace_put(trace, (char *)buf, TRACE_RECORD_SIZE);
+}
+
+void trace_write(struct trace *trace, const struct trace_record *r)
+{
+	if (trace->binary) {
+		__trace_put_binary(trace, r);
+		return;
+	}
+
+	__trace_put_uint(trace, r->tick, 3);
+	if (trace->show_cpu) {
+		__trace_put(trace, "@", 1);
+		__trace_put_uint(trace, r->cpu, 0);
+	}
+	__trace_put(trace, ": ", 2);
+
+	if (r->kind == TRACE_IDLE) {
+		__trace_put(trace, "idle", 4);
+		__trace_put_repeats(trace, r->arg);
+		goto out;
+	}
+
+	__trace_put_indent(trace, r->pid);
+
+	switch (r->kind) {
+	case TRACE_FORK:
+		__trace_put(trace, "N", 1);
+		break;
+	case TRACE_EXIT:
+		__trace_put(trace, "X", 1);
+		break;
+	case TRACE_BLOCK:
+		__trace_put(trace, "=", 1);
+		break;
+	case TRACE_ACQUIRE:
+		__trace_put(trace, "+", 1);
+		__trace_put_uint(trace, r->arg, 0);
+		break;
+	case TRACE_RELEASE:
+		__trace_put(trace, "-", 1);
+		__trace_put_uint(trace, r->arg, 0);
+		break;
+	case TRACE_RUN:
+		__trace_put_uint(trace, r->pid, 0);
+		__trace_put_repeats(trace, r->arg);
+		break;
+	case TRACE_SWITCH:
+		__trace_put(trace, "~", 1);
+		__trace_put_repeats(trace, r->arg);
+		break;
+	}
+
+out:
+	__trace_put(trace, "\n", 1);
+	if (trace->autoflush) trace_flush(trace);
+}
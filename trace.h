@@ -0,0 +1,134 @@
+/**********************************************************************
+ * Copyright (c) 2019
+ *  Sang-Hoon Kim <sanghoonkim@ajou.ac.kr>
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License version 2 as
+ * published by the Free Software Foundation.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTIABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+ * GNU General Public License for more details.
+ *
+ **********************************************************************/
+
+#ifndef __TRACE_H__
+#define __TRACE_H__
+
+#include <stdio.h>
+
+#include "types.h"
+
+/**
+ * Scheduling events to trace
+ */
+enum trace_kind {
+	TRACE_FORK,			/* N: Forked */
+	TRACE_EXIT,			/* X: Finished */
+	TRACE_BLOCK,		/* =: Blocked */
+	TRACE_ACQUIRE,		/* +n: Acquire resource n */
+	TRACE_RELEASE,		/* -n: Release resource n */
+	TRACE_RUN,			/* The process ran for @arg ticks */
+	TRACE_IDLE,			/* The processor idled for @arg ticks */
+	TRACE_SWITCH,		/* ~: The processor switched to the process for @arg ticks */
+};
+
+struct trace_record {
+	unsigned int tick;
+	unsigned int pid;
+	unsigned int arg;	/* Resource id for +n/-n, # of ticks for run/idle/switch */
+	unsigned short cpu;
+	unsigned char kind;
+};
+
+/**
+ * Binary trace format. The file starts with the header below, and is followed
+ * by fixed-width records. All fields are in little endian as follows;
+ *
+ *   header: "SCHEDTRC" version:u32 show_cpu:u32
+ *   record: tick:u32 pid:u32 arg:u32 cpu:u16 kind:u8 reserved:u8
+ */
+#define TRACE_MAGIC			"SCHEDTRC"
+#define TRACE_VERSION		1
+#define TRACE_HEADER_SIZE	16
+#define TRACE_RECORD_SIZE	16
+
+#define TRACE_BUFFER_SIZE	(1 << 20)
+
+/**
+ * Buffered trace writer. Records are rendered into @buffer and written out
+ * with a single write() when the buffer is full or the trace is flushed.
+ */
+struct trace {
+	int fd;
+	bool binary;		/* Write records in the binary format */
+	bool show_cpu;		/* Tag events with the CPU id */
+	bool autoflush;		/* Flush on every record (e.g., to a terminal) */
+	size_t len;
+	char *buffer;
+};
+
+
+/***********************************************************************
+ * trace_open()
+ *
+ * DESCRIPTION
+ *   Start writing the trace into @file. The events are tagged with the CPU
+ *   id if @show_cpu is true. The trace is flushed on every record if @file
+ *   is a terminal.
+ */
+void trace_open(struct trace *trace, FILE *file, bool show_cpu);
+
+
+/***********************************************************************
+ * trace_open_binary()
+ *
+ * DESCRIPTION
+ *   Same as trace_open() but the records are written into @file in the
+ *   binary format. @show_cpu is kept in the header for the renderers.
+ */
+void trace_open_binary(struct trace *trace, FILE *file, bool show_cpu);
+
+
+/***********************************************************************
+ * trace_write()
+ *
+ * DESCRIPTION
+ *   Append @record to @trace in the text format as follows;
+ *
+ *     "%3d: " + (4 * pid spaces) + "N"
+ *
+ *   The idle events are not indented, and the run, idle, and switch events
+ *   for more than one tick are suffixed with " x<ticks>".
+ */
+void trace_write(struct trace *trace, const struct trace_record *record);
+
+
+/***********************************************************************
+ * trace_flush() / trace_close()
+ *
+ * DESCRIPTION
+ *   Write out the buffered records. trace_close() flushes the trace and
+ *   releases the buffer. The underlying file is not closed.
+ */
+void trace_flush(struct trace *trace);
+void trace_close(struct trace *trace);
+
+
+/***********************************************************************
+ * trace_read_header() / trace_read()
+ *
+ * DESCRIPTION
+ *   Read the header and the records of a binary trace from @file.
+ *
+ * RETURN VALUE
+ *   trace_read_header() returns true if @file starts with a valid header,
+ *   and puts whether the records are tagged with the CPU into @show_cpu.
+ *   trace_read() returns true if a record is read into @record, and false
+ *   at the end of the trace.
+ */
+bool trace_read_header(FILE *file, bool *show_cpu);
+bool trace_read(FILE *file, struct trace_record *record);
+
+#endif
@@ -0,0 +1,189 @@
+/**********************************************************************
+ * Copyright (c) 2019
+ *  Sang-Hoon Kim <sanghoonkim@ajou.ac.kr>
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License version 2 as
+ * published by the Free Software Foundation.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTIABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+ * GNU General Public License for more details.
+ *
+ **********************************************************************/
+
+/**
+ * Render a binary trace written with "sched -o" into the text format that
+ * sched prints to stderr, or summarize it.
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <getopt.h>
+
+#include "types.h"
+#include "trace.h"
+
+struct process_summary {
+	bool forked;
+	unsigned int forked_at;
+	unsigned int exited_at;
+	unsigned int nr_run;
+	unsigned int nr_blocked;
+	unsigned int nr_acquired;
+};
+
+static struct process_summary *__processes = NULL;
+static unsigned int __nr_processes = 0;
+
+static struct process_summary *__get_process(unsigned int pid)
+{
+	if (pid >= __nr_processes) {
+		unsigned int nr = __nr_processes ? __nr_processes : 64;
+
+		while (nr <= pid) nr *= 2;
+		__processes = realloc(__processes, sizeof(*__processes) * nr);
+		memset(__processes + __nr_processes, 0x00,
+				sizeof(*__processes) * (nr - __nr_processes));
+		__nr_processes = nr;
+	}
+	return __processes + pid;
+}
+
+static void __summarize(FILE *file)
+{
+	unsigned long nr_events[TRACE_SWITCH + 1] = { 0 };
+	unsigned long nr_run = 0, nr_idle = 0, nr_switching = 0;
+	unsigned int last_tick = 0;
+	struct trace_record r;
+
+	while (trace_read(file, &r)) {
+		struct process_summary *p = NULL;
+		unsigned int end = r.tick;
+
+		if (r.kind > TRACE_SWITCH) continue;
+		nr_events[r.kind]++;
+
+		if (r.kind != TRACE_IDLE) p = __get_process(r.pid);
+
+		switch (r.kind) {
+		case TRACE_FORK:
+			p->forked = true;
+			p->forked_at = r.tick;
+			break;
+		case TRACE_EXIT:
+			p->exited_at = r.tick;
+			break;
+		case TRACE_BLOCK:
+			p->nr_blocked++;
+			break;
+		case TRACE_ACQUIRE:
+			p->nr_acquired++;
+			break;
+		case TRACE_RUN:
+			p->nr_run += r.arg;
+			nr_run += r.arg;
+			end += r.arg - 1;
+			break;
+		case TRACE_IDLE:
+			nr_idle += r.arg;
+			end += r.arg - 1;
+			break;
+		case TRACE_SWITCH:
+			nr_switching += r.arg;
+			end += r.arg - 1;
+			break;
+		}
+		if (end > last_tick) last_tick = end;
+	}
+
+	printf("***** EVENTS ******************\n");
+	printf("Ticks       : %u\n", last_tick + 1);
+	printf("Forks       : %lu\n", nr_events[TRACE_FORK]);
+	printf("Exits       : %lu\n", nr_events[TRACE_EXIT]);
+	printf("Acquisitions: %lu\n", nr_events[TRACE_ACQUIRE]);
+	printf("Releases    : %lu\n", nr_events[TRACE_RELEASE]);
+	printf("Blocked     : %lu ticks\n", nr_events[TRACE_BLOCK]);
+	printf("Running     : %lu ticks\n", nr_run);
+	printf("Idle        : %lu ticks\n", nr_idle);
+	if (nr_switching) printf("Switching   : %lu ticks\n", nr_switching);
+
+	printf("\n");
+	printf("***** PROCESSES ***************\n");
+	printf("  pid   forked   exited      run  blocked acquired\n");
+	for (unsigned int pid = 0; pid < __nr_processes; pid++) {
+		struct process_summary *p = __processes + pid;
+
+		if (!p->forked) continue;
+		printf("%5u %8u %8u %8u %8u %8u\n", pid, p->forked_at, p->exited_at,
+				p->nr_run, p->nr_blocked, p->nr_acquired);
+	}
+}
+
+static void __render(FILE *file, bool show_cpu)
+{
+	struct trace trace;
+	struct trace_record r;
+
+	trace_open(&trace, stdout, show_cpu);
+	while (trace_read(file, &r)) {
+		trace_write(&trace, &r);
+	}
+	trace_close(&trace);
+}
+
+static void __print_usage(char * const name)
+{
+	printf("Usage: %s {-s} [binary trace file]\n", name);
+	printf("\n");
+	printf("  -s: Print the summary instead of the events\n\n");
+}
+
+int main(int argc, char * const argv[])
+{
+	int opt;
+	bool summary = false;
+	bool show_cpu;
+	FILE *file;
+
+	while ((opt = getopt(argc, argv, "sh")) != -1) {
+		switch (opt) {
+		case 's':
+			summary = true;
+			break;
+		case 'h':
+		default:
+			__print_usage(argv[0]);
+			return EXIT_FAILURE;
+		}
+	}
+
+	if (optind >= argc) {
+		__print_usage(argv[0]);
+		return EXIT_FAILURE;
+	}
+
+	file = fopen(argv[optind], "r");
+	if (!file) {
+		fprintf(stderr, "Unable to open %s\n", argv[optind]);
+		return EXIT_FAILURE;
+	}
+
+	if (!trace_read_header(file, &show_cpu)) {
+		fprintf(stderr, "%s is not a binary trace\n", argv[optind]);
+		fclose(file);
+		return EXIT_FAILURE;
+	}
+
+	if (summary) {
+		__summarize(file);
+	} else {
+		__render(file, show_cpu);
+	}
+
+	fclose(file);
+	return EXIT_SUCCESS;
+}
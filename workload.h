@@ -0,0 +1,76 @@
+/**********************************************************************
+ * Copyright (c) 2019
+ *  Sang-Hoon Kim <sanghoonkim@ajou.ac.kr>
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License version 2 as
+ * published by the Free Software Foundation.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTIABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+ * GNU General Public License for more details.
+ *
+ **********************************************************************/
+
+#ifndef __WORKLOAD_H__
+#define __WORKLOAD_H__
+
+#include <stdint.h>
+
+/**
+ * Precompiled workload image made with "sched --compile". The image is
+ * mapped into the memory and used in place, so it is a flat array of
+ * fixed-width records in the byte order of the machine that compiled it;
+ *
+ *   struct workload_header
+ *   struct workload_process   processes[nr_processes]
+ *   struct workload_schedule  schedules[nr_schedules]
+ *   struct workload_resource  resources[nr_declarations]
+ *
+ * The processes are sorted by the fork time, and the resource schedules of
+ * a process are laid out consecutively in the order of the script.
+ */
+#define WORKLOAD_MAGIC		"SCHEDWL"
+#define WORKLOAD_VERSION	3
+#define WORKLOAD_BYTE_ORDER	0x01020304
+
+struct workload_header {
+	char magic[8];
+	uint32_t version;
+	uint32_t byte_order;	/* WORKLOAD_BYTE_ORDER in the compiler's order */
+	uint64_t nr_processes;
+	uint64_t nr_schedules;
+	uint32_t nr_resources;	/* The largest resource id used + 1 */
+	uint32_t nr_declarations;
+};
+
+struct workload_process {
+	uint32_t pid;
+	uint32_t starts_at;
+	uint32_t lifespan;
+	uint32_t prio;
+	uint64_t schedule;		/* Index of the first resource schedule */
+	uint32_t nr_schedules;
+	uint32_t reserved;
+};
+
+#define WORKLOAD_SCHEDULE_SHARED	0x1
+
+struct workload_schedule {
+	uint32_t resource_id;
+	uint32_t at;
+	uint32_t duration;
+	uint32_t flags;
+};
+
+/**
+ * Resources declared other than mutexes
+ */
+struct workload_resource {
+	uint32_t resource_id;
+	uint32_t kind;			/* enum resource_kind */
+	uint32_t capacity;
+};
+
+#endif